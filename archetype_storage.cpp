@@ -0,0 +1,393 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "archetype_storage.h"
+
+#include <algorithm>
+
+namespace ecs
+{
+archetype::archetype(const bitflag& signature)
+    : mSignature(signature)
+    , mColumns(signature.size(), NO_COLUMN)
+{
+    for (size_t tag : signature.set_bits()) {
+        mColumns[tag] = mNumOfColumns++;
+    }
+
+    size_t rowSize = sizeof(entity_id) + mNumOfColumns * sizeof(component_ptr);
+    mChunkCapacity = std::max<size_t>(1, CHUNK_BYTES / rowSize);
+}
+
+size_t archetype::column(component_tag tag) const
+{
+    if (mColumns.size() <= tag) {
+        return NO_COLUMN;
+    }
+    return mColumns[tag];
+}
+
+entity_id archetype::id(size_t row) const
+{
+    return mChunks[row / mChunkCapacity]->entities[row % mChunkCapacity];
+}
+
+const component_ptr& archetype::at(size_t row, size_t column) const
+{
+    const chunk& c = *mChunks[row / mChunkCapacity];
+    return c.columns[column * mChunkCapacity + row % mChunkCapacity];
+}
+
+component_ptr& archetype::at(size_t row, size_t column)
+{
+    chunk& c = *mChunks[row / mChunkCapacity];
+    return c.columns[column * mChunkCapacity + row % mChunkCapacity];
+}
+
+size_t archetype::push(entity_id id)
+{
+    if (mSize == mChunks.size() * mChunkCapacity) {
+        auto c = std::make_unique<chunk>();
+        c->entities.resize(mChunkCapacity);
+        c->columns.resize(mChunkCapacity * mNumOfColumns);
+        mChunks.push_back(std::move(c));
+    }
+
+    size_t row = mSize++;
+    mChunks[row / mChunkCapacity]->entities[row % mChunkCapacity] = id;
+    return row;
+}
+
+void archetype::erase(size_t row)
+{
+    size_t last = mSize - 1;
+    if (row != last) {
+        mChunks[row / mChunkCapacity]->entities[row % mChunkCapacity] = id(last);
+        for (size_t column = 0; column < mNumOfColumns; ++column) {
+            at(row, column) = std::move(at(last, column));
+        }
+    }
+    for (size_t column = 0; column < mNumOfColumns; ++column) {
+        at(last, column).reset();
+    }
+
+    --mSize;
+    if (mSize == (mChunks.size() - 1) * mChunkCapacity) {
+        mChunks.pop_back();
+    }
+}
+
+archetype_storage::archetype_storage()
+{
+    mArchetypes.push_back(std::make_unique<archetype>(bitflag(0)));
+    mIndex.emplace(bitflag(0), mArchetypes.front().get());
+}
+
+void archetype_storage::create(entity_id id)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    place(id);
+}
+
+bool archetype_storage::destroy(entity_id id, bitflag& components)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    location* found = locate(id);
+    if (!found) {
+        return false;
+    }
+
+    components = found->type->signature();
+    location loc = *found;
+    *found = location{ nullptr, 0 };
+    erase(loc);
+    return true;
+}
+
+bool archetype_storage::insert(entity_id id, component_ptr c)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return attach(id, std::move(c));
+}
+
+bool archetype_storage::attach(entity_id id, component_ptr c)
+{
+    location* loc = locate(id);
+    if (!loc) {
+        return false;
+    }
+
+    component_tag tag = c->tag();
+    if (loc->type->column(tag) != archetype::NO_COLUMN) {
+        return false;
+    }
+
+    move(id, *loc, with(loc->type, tag));
+    loc->type->at(loc->row, loc->type->column(tag)) = std::move(c);
+    return true;
+}
+
+bool archetype_storage::update(entity_id id, component_ptr c)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    const location* loc = locate(id);
+    if (!loc) {
+        return false;
+    }
+
+    size_t column = loc->type->column(c->tag());
+    if (column == archetype::NO_COLUMN) {
+        return false;
+    }
+
+    component_ptr& current = loc->type->at(loc->row, column);
+    if (!accept_revision(*current, *c)) {
+        return false;
+    }
+
+    current = std::move(c);
+    return true;
+}
+
+bool archetype_storage::remove(entity_id id, component_tag tag)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    location* loc = locate(id);
+    if (!loc) {
+        return false;
+    }
+
+    if (loc->type->column(tag) == archetype::NO_COLUMN) {
+        return false;
+    }
+
+    move(id, *loc, without(loc->type, tag));
+    return true;
+}
+
+component_ptr archetype_storage::get(entity_id id, component_tag tag) const
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    const location* loc = locate(id);
+    if (!loc) {
+        return nullptr;
+    }
+
+    size_t column = loc->type->column(tag);
+    if (column == archetype::NO_COLUMN) {
+        return nullptr;
+    }
+    return loc->type->at(loc->row, column);
+}
+
+void archetype_storage::create_many(const std::vector<entity_id>& ids)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (entity_id id : ids) {
+        place(id);
+    }
+}
+
+void archetype_storage::insert_many(batch& components)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto notInserted = std::remove_if(components.begin(), components.end(),
+        [this](const auto& entry) { return !attach(entry.first, entry.second); });
+    components.erase(notInserted, components.end());
+}
+
+void archetype_storage::collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+    std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::vector<size_t> columns(tags.size());
+    for (const auto& type : mArchetypes)
+    {
+        if (type->size() == 0 || !type->signature().has(bf) || type->signature().intersects(excluded)) {
+            continue;
+        }
+
+        for (size_t i = 0; i < tags.size(); ++i) {
+            columns[i] = type->column(tags[i]);
+        }
+
+        const size_t capacity = type->capacity();
+        size_t remaining = type->size();
+        for (const auto& c : type->chunks())
+        {
+            size_t rows = std::min(remaining, capacity);
+            remaining -= rows;
+            for (size_t row = 0; row < rows; ++row) {
+                entities.push_back(c->entities[row]);
+                for (size_t column : columns) {
+                    if (column == archetype::NO_COLUMN) {
+                        components.push_back(nullptr);
+                    } else {
+                        components.push_back(c->columns[column * capacity + row]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+struct archetype_storage::row_cursor : public storage::cursor
+{
+    row_cursor(const archetype_storage& owner, const bitflag& bf, const bitflag& excluded,
+        const std::vector<component_tag>& tags)
+        : mOwner(owner), mBitflag(bf), mExcluded(excluded), mTags(tags) {}
+
+    bool next(entity_id& id, std::vector<component_const_ptr>& components) override {
+        std::unique_lock<std::mutex> lock(mOwner.mMutex);
+        for (; mType < mOwner.mArchetypes.size(); ++mType, mRow = 0) {
+            const archetype& type = *mOwner.mArchetypes[mType];
+            if (mRow >= type.size() || !type.signature().has(mBitflag) || type.signature().intersects(mExcluded)) {
+                continue;
+            }
+
+            id = type.id(mRow);
+            for (size_t i = 0; i < mTags.size(); ++i) {
+                size_t column = type.column(mTags[i]);
+                components[i] = column == archetype::NO_COLUMN ? nullptr : type.at(mRow, column);
+            }
+            ++mRow;
+            return true;
+        }
+        return false;
+    }
+
+    const archetype_storage& mOwner;
+    const bitflag& mBitflag;
+    const bitflag& mExcluded;
+    const std::vector<component_tag>& mTags;
+    size_t mType = 0;
+    size_t mRow = 0;
+};
+
+std::unique_ptr<storage::cursor> archetype_storage::open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const
+{
+    return std::make_unique<row_cursor>(*this, bf, excluded, tags);
+}
+
+void archetype_storage::place(entity_id id)
+{
+    archetype* empty = mArchetypes.front().get();
+    entity_index index = index_of(id);
+    if (mLocations.size() <= index) {
+        mLocations.resize(index + 1);
+    }
+    mLocations[index] = location{ empty, empty->push(id) };
+}
+
+archetype_storage::location* archetype_storage::locate(entity_id id)
+{
+    const auto* self = this;
+    return const_cast<location*>(self->locate(id));
+}
+
+const archetype_storage::location* archetype_storage::locate(entity_id id) const
+{
+    entity_index index = index_of(id);
+    if (mLocations.size() <= index) {
+        return nullptr;
+    }
+
+    const location& loc = mLocations[index];
+    if (!loc.type || loc.type->id(loc.row) != id) {
+        return nullptr;
+    }
+    return &loc;
+}
+
+archetype* archetype_storage::find(const bitflag& signature)
+{
+    auto found = mIndex.find(signature);
+    if (found != mIndex.end()) {
+        return found->second;
+    }
+
+    mArchetypes.push_back(std::make_unique<archetype>(signature));
+    archetype* created = mArchetypes.back().get();
+    mIndex.emplace(signature, created);
+    return created;
+}
+
+archetype* archetype_storage::with(archetype* source, component_tag tag)
+{
+    if (source->withEdges.size() <= tag) {
+        source->withEdges.resize(tag + 1, nullptr);
+    }
+
+    archetype*& target = source->withEdges[tag];
+    if (!target) {
+        bitflag signature(source->signature());
+        if (signature.size() <= tag) {
+            signature.resize(tag + 1);
+        }
+        signature.set(tag, true);
+        target = find(signature);
+    }
+    return target;
+}
+
+archetype* archetype_storage::without(archetype* source, component_tag tag)
+{
+    if (source->withoutEdges.size() <= tag) {
+        source->withoutEdges.resize(tag + 1, nullptr);
+    }
+
+    archetype*& target = source->withoutEdges[tag];
+    if (!target) {
+        bitflag signature(source->signature());
+        signature.set(tag, false);
+        target = find(signature);
+    }
+    return target;
+}
+
+void archetype_storage::move(entity_id id, location& loc, archetype* target)
+{
+    archetype* source = loc.type;
+    size_t row = target->push(id);
+    const bitflag& signature = source->signature();
+    for (size_t tag : signature.set_bits()) {
+        size_t targetColumn = target->column(tag);
+        if (targetColumn == archetype::NO_COLUMN) {
+            continue;
+        }
+        target->at(row, targetColumn) = std::move(source->at(loc.row, source->column(tag)));
+    }
+
+    erase(loc);
+    loc = location{ target, row };
+}
+
+void archetype_storage::erase(const location& loc)
+{
+    loc.type->erase(loc.row);
+    if (loc.row < loc.type->size()) {
+        mLocations[index_of(loc.type->id(loc.row))].row = loc.row;
+    }
+}
+} // namespace ecs
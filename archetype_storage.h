@@ -0,0 +1,123 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "storage.h"
+
+namespace ecs
+{
+// Group of entities having exactly the same set of components. Rows are kept
+// in fixed-size chunks, each chunk stores a column per component type
+// (structure of arrays), so iterating over an archetype touches contiguous memory.
+struct archetype
+{
+    static constexpr size_t CHUNK_BYTES = 16 * 1024;
+    static constexpr size_t NO_COLUMN = static_cast<size_t>(-1);
+
+    struct chunk
+    {
+        std::vector<entity_id> entities;
+        std::vector<component_ptr> columns; // column-major, 'capacity' rows per column
+    };
+
+    explicit archetype(const bitflag& signature);
+
+    const bitflag& signature() const { return mSignature; }
+    size_t size() const { return mSize; }
+    size_t capacity() const { return mChunkCapacity; }
+    size_t column(component_tag tag) const;
+    const std::vector<std::unique_ptr<chunk>>& chunks() const { return mChunks; }
+
+    entity_id id(size_t row) const;
+    const component_ptr& at(size_t row, size_t column) const;
+    component_ptr& at(size_t row, size_t column);
+
+    size_t push(entity_id id);
+    // moves the last row into place of the removed one
+    void erase(size_t row);
+
+    // cached neighbours in the archetype graph
+    std::vector<archetype*> withEdges;
+    std::vector<archetype*> withoutEdges;
+
+private:
+    bitflag mSignature;
+    std::vector<size_t> mColumns; // indexed by component tag
+    size_t mNumOfColumns = 0;
+    size_t mChunkCapacity = 0;
+    size_t mSize = 0;
+    std::vector<std::unique_ptr<chunk>> mChunks;
+};
+
+struct archetype_storage : public storage
+{
+    archetype_storage();
+
+    void create(entity_id id) override;
+    bool destroy(entity_id id, bitflag& components) override;
+    bool insert(entity_id id, component_ptr c) override;
+    bool update(entity_id id, component_ptr c) override;
+    bool remove(entity_id id, component_tag tag) override;
+    component_ptr get(entity_id id, component_tag tag) const override;
+    void create_many(const std::vector<entity_id>& ids) override;
+    void insert_many(batch& components) override;
+    void collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+        std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const override;
+    std::unique_ptr<cursor> open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const override;
+
+private:
+    struct row_cursor;
+
+    struct location
+    {
+        archetype* type = nullptr;
+        size_t row = 0;
+    };
+
+    // has to be called with mMutex locked
+    void place(entity_id id);
+    bool attach(entity_id id, component_ptr c);
+    // stale ids are not found
+    location* locate(entity_id id);
+    const location* locate(entity_id id) const;
+    archetype* find(const bitflag& signature);
+    archetype* with(archetype* source, component_tag tag);
+    archetype* without(archetype* source, component_tag tag);
+    // moves entity to another archetype copying all the components both have in common
+    void move(entity_id id, location& loc, archetype* target);
+    void erase(const location& loc);
+
+private:
+    std::vector<std::unique_ptr<archetype>> mArchetypes;
+    std::unordered_map<bitflag, archetype*> mIndex; // by signature
+    std::vector<location> mLocations; // indexed by index_of(id)
+    mutable std::mutex mMutex;
+};
+} // namespace ecs
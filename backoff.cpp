@@ -0,0 +1,51 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "backoff.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ecs
+{
+constexpr size_t backoff::YIELDS;
+constexpr std::chrono::microseconds backoff::MAX_DELAY;
+
+void backoff::pause()
+{
+    if (mStep < YIELDS) {
+        ++mStep;
+        std::this_thread::yield();
+        return;
+    }
+
+    size_t shift = std::min<size_t>(mStep++ - YIELDS, 10);
+    std::this_thread::sleep_for(std::min(std::chrono::microseconds(1 << shift), MAX_DELAY));
+}
+
+void backoff::reset()
+{
+    mStep = 0;
+}
+} // namespace ecs
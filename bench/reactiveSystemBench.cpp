@@ -0,0 +1,107 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+// Measures enqueue and dequeue throughput of a reactive_system task queue with
+// many producers posting small commands to the single system thread.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <reactive_system.h>
+
+namespace
+{
+const size_t TASKS_PER_PRODUCER = 200000;
+
+struct Increment : ecs::command
+{
+    explicit Increment(std::atomic<size_t>& counter) : counter(counter) {}
+    void execute() override {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<size_t>& counter;
+};
+
+struct BenchSystem : ecs::reactive_system
+{
+    using ecs::reactive_system::add_task;
+};
+
+struct result
+{
+    double enqueued;
+    double executed;
+};
+
+result measure(size_t numOfProducers)
+{
+    BenchSystem system;
+    std::atomic<size_t> executed{ 0 };
+    const size_t total = numOfProducers * TASKS_PER_PRODUCER;
+    system.start();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < numOfProducers; ++p) {
+        producers.emplace_back([&system, &executed]() {
+            for (size_t i = 0; i < TASKS_PER_PRODUCER; ++i) {
+                system.add_task(std::make_unique<Increment>(executed));
+            }
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+    std::chrono::duration<double> enqueueing = std::chrono::steady_clock::now() - start;
+
+    while (executed.load(std::memory_order_relaxed) < total) {
+        std::this_thread::yield();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    system.stop();
+    system.join();
+
+    return { total / enqueueing.count(), total / elapsed.count() };
+}
+}
+
+int main()
+{
+    const size_t producerCounts[] = { 1, 2, 4, 8, 16 };
+
+    std::cout << std::setw(10) << "producers" << std::setw(20) << "enqueue [task/s]"
+              << std::setw(20) << "execute [task/s]" << std::endl;
+    for (size_t producers : producerCounts) {
+        result r = measure(producers);
+        std::cout << std::setw(10) << producers << std::setw(20) << std::fixed << std::setprecision(0)
+                  << r.enqueued << std::setw(20) << r.executed << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+// Measures throughput of concurrent writers touching disjoint entities
+// for every storage engine, with a single shard and with one shard per thread.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <registry.h>
+
+namespace
+{
+struct Counter : ecs::component
+{
+    ECS_COMPONENT(Counter)
+
+    int value = 0;
+};
+
+const size_t ENTITIES_PER_THREAD = 1000;
+const size_t UPDATES_PER_THREAD = 50000;
+
+double measure(ecs::storage_t type, size_t numOfShards, size_t numOfThreads)
+{
+    ecs::registry reg(type, numOfShards);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < numOfThreads; ++t) {
+        writers.emplace_back([&reg]() {
+            std::vector<ecs::entity_id> ids;
+            for (size_t i = 0; i < ENTITIES_PER_THREAD; ++i) {
+                ecs::entity_id e = reg.createEntity();
+                reg.insert(e, Counter());
+                ids.push_back(e);
+            }
+            for (size_t i = 0; i < UPDATES_PER_THREAD; ++i) {
+                ecs::entity_id e = ids[i % ids.size()];
+                auto updated = reg.select<Counter>(e)->clone();
+                ++updated.value;
+                reg.update(e, std::move(updated));
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double operations = static_cast<double>(numOfThreads * (ENTITIES_PER_THREAD * 2 + UPDATES_PER_THREAD * 2));
+    return operations / elapsed.count();
+}
+
+const char* name(ecs::storage_t type)
+{
+    switch (type) {
+    case ecs::storage_t::entity_map: return "entity_map";
+    case ecs::storage_t::sparse_set: return "sparse_set";
+    case ecs::storage_t::archetype: return "archetype";
+    }
+    return "";
+}
+}
+
+int main()
+{
+    const size_t threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+    const ecs::storage_t types[] = {
+        ecs::storage_t::entity_map,
+        ecs::storage_t::sparse_set,
+        ecs::storage_t::archetype
+    };
+
+    std::cout << std::setw(12) << "storage" << std::setw(10) << "threads"
+              << std::setw(18) << "1 shard [op/s]" << std::setw(18) << "32 shards [op/s]" << std::endl;
+    for (auto type : types) {
+        for (size_t threads : threadCounts) {
+            std::cout << std::setw(12) << name(type) << std::setw(10) << threads
+                      << std::setw(18) << std::fixed << std::setprecision(0) << measure(type, 1, threads)
+                      << std::setw(18) << measure(type, 32, threads) << std::endl;
+        }
+    }
+    return 0;
+}
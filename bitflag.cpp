@@ -24,148 +24,321 @@
 
 #include "bitflag.h"
 
+#include <bitset>
 #include <cstring>
-#include <iostream>
 
-struct bitflag_private
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+constexpr size_t bitflag::WORD_BITS;
+constexpr size_t bitflag::INLINE_WORDS;
+constexpr size_t bitflag::INLINE_BITS;
+
+namespace
+{
+// w has to be non-zero
+size_t countTrailingZeros(bitflag::word w)
 {
-    size_t size;
-    size_t enabledFlagsCount;
-    void* bits;
-};
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, w);
+    return index;
+#else
+    return __builtin_ctzll(w);
+#endif
+}
+}
 
 bitflag::bitflag(size_t size)
-    : data(std::make_unique<bitflag_private>())
+    : mSize(size)
+    , mCapacity(std::max(wordsFor(size), INLINE_WORDS))
 {
-    data->size = size;
-    data->enabledFlagsCount = 0;
-    auto res = std::lldiv(data->size, 8);
-    size_t bytes = res.quot;
-    bytes += res.rem > 0 ? 1 : 0;
-    data->bits = std::calloc(bytes, sizeof(char));
+    if (isInline()) {
+        std::fill(mInline, mInline + INLINE_WORDS, 0);
+    } else {
+        mHeap = new word[mCapacity]();
+    }
 }
 
 bitflag::bitflag(const bitflag& other)
-    : data(std::make_unique<bitflag_private>())
+    : mSize(other.mSize)
+    , mCapacity(std::max(other.words(), INLINE_WORDS))
 {
-    data->size = other.data->size;
-    data->enabledFlagsCount = other.data->enabledFlagsCount;
-    auto res = std::lldiv(data->size, 8);
-    size_t bytes = res.quot;
-    bytes += res.rem > 0 ? 1 : 0;
-    data->bits = std::malloc(bytes);
-    memcpy(data->bits, other.data->bits, bytes);
+    if (!isInline()) {
+        mHeap = new word[mCapacity];
+    }
+    std::copy(other.bits(), other.bits() + mCapacity, bits());
 }
 
 bitflag::bitflag(bitflag&& other)
-    : data(std::move(other.data))
+    : mSize(0)
+    , mCapacity(INLINE_WORDS)
 {
+    take(other);
 }
 
 bitflag::~bitflag()
 {
-    if (data) {
-        std::free(data->bits);
+    if (!isInline()) {
+        delete[] mHeap;
+    }
+}
+
+bitflag& bitflag::operator=(const bitflag& other)
+{
+    if (this != &other) {
+        bitflag copy(other);
+        take(copy);
     }
+    return *this;
+}
+
+bitflag& bitflag::operator=(bitflag&& other)
+{
+    if (this != &other) {
+        take(other);
+    }
+    return *this;
 }
 
 bool bitflag::at(size_t pos) const
 {
-    assert(pos < data->size);
-    auto res = std::lldiv(pos, 8);
-    size_t byteOffset = res.quot;
-    size_t restOffset = res.rem;
-    char* byte = (char*)data->bits;
-    byte += byteOffset;
-    return *byte & (1 << restOffset);
+    assert(pos < mSize);
+    return (bits()[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1;
 }
 
 void bitflag::set(size_t pos, bool value)
 {
-    assert(pos < data->size);
-    auto res = std::lldiv(pos, 8);
-    char* byte = (char*)data->bits;
-    byte += res.quot;
+    assert(pos < mSize);
+    word mask = word(1) << (pos % WORD_BITS);
     if (value) {
-        *byte |= (1 << res.rem); ++data->enabledFlagsCount;
+        bits()[pos / WORD_BITS] |= mask;
     } else {
-        *byte &= ~(1 << res.rem); --data->enabledFlagsCount;
+        bits()[pos / WORD_BITS] &= ~mask;
     }
 }
 
-size_t bitflag::size() const { return data->size; }
+size_t bitflag::size() const { return mSize; }
 
 void bitflag::resize(size_t size)
 {
-    auto res = std::lldiv(size, 8);
-    size_t bytes = res.quot;
-    bytes += res.rem > 0 ? 1 : 0;
-    data->bits = realloc(data->bits, bytes);
-    size_t oldSize = data->size;
-    data->size = size;
-    for (size_t i=oldSize; i<size; ++i)
-    {
-        set(i, false);
-    }
+    grow(size);
 
+    size_t oldWords = words();
+    mSize = size;
+    if (words() < oldWords) {
+        std::fill(bits() + words(), bits() + oldWords, 0);
+    }
+    clearTail();
 }
 
-size_t bitflag::enabled_flags_count() const { return data->enabledFlagsCount; }
+size_t bitflag::enabled_flags_count() const
+{
+    size_t count = 0;
+    const word* w = bits();
+    for (size_t i = 0; i < words(); ++i) {
+        count += std::bitset<WORD_BITS>(w[i]).count();
+    }
+    return count;
+}
 
 bool bitflag::has(const bitflag& rhs) const
 {
-    if (data->size < rhs.data->size) {
-        return false;
+    const word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    size_t common = std::min(words(), rhs.words());
+
+    // branch-free over the common part so the loop can be vectorized
+    word missing = 0;
+    for (size_t i = 0; i < common; ++i) {
+        missing |= rhsWords[i] & ~lhsWords[i];
+    }
+    for (size_t i = common; i < rhs.words(); ++i) {
+        missing |= rhsWords[i];
     }
+    return missing == 0;
+}
 
-    size_t bitsToCheck = std::min(data->size, rhs.data->size);
-    auto res = std::lldiv(bitsToCheck, 8);
-    size_t bytes = res.quot;
-    bytes += res.rem > 0 ? 1 : 0;
-    char* byte = (char*)data->bits;
-    char* rhsByte = (char*)rhs.data->bits;
-    for (size_t i=0; i<bytes-1; ++i)
-    {
-        if (bitsToCheck > 8) {
-            bitsToCheck -= 8;
-        }
-        else {
-            bitsToCheck = 0;
-        }
+bool bitflag::intersects(const bitflag& rhs) const
+{
+    const word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    size_t common = std::min(words(), rhs.words());
 
-        if (*byte == 0 && *rhsByte == 0)
-        {
-            ++byte;
-            ++rhsByte;
-            continue;
-        }
-        if (!(*byte & *rhsByte))
-        {
-            return false;
-        }
-        ++byte;
-        ++rhsByte;
+    word shared = 0;
+    for (size_t i = 0; i < common; ++i) {
+        shared |= lhsWords[i] & rhsWords[i];
     }
+    return shared != 0;
+}
 
-    if (bitsToCheck == 0) {
-        return true;
-    }
+bool bitflag::operator==(const bitflag& rhs) const
+{
+    // flags beyond size of the shorter bitflag are treated as disabled
+    const bitflag& longer = words() >= rhs.words() ? *this : rhs;
+    const word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    size_t common = std::min(words(), rhs.words());
 
-    char mask = 0;
-    for (size_t i=0; i<bitsToCheck; ++i)
-    {
-        mask |= (1 << i);
+    word difference = 0;
+    for (size_t i = 0; i < common; ++i) {
+        difference |= lhsWords[i] ^ rhsWords[i];
     }
-    char val1 = *byte & mask;
-    char val2 = *rhsByte & mask;
-    return (val1 & val2) == val2;
+    for (size_t i = common; i < longer.words(); ++i) {
+        difference |= longer.bits()[i];
+    }
+    return difference == 0;
 }
 
 bitflag bitflag::operator!() const
 {
     bitflag res(*this);
-    for (size_t i = 0; i < res.size(); ++i) {
-        res.set(i, !res.at(i));
+    word* w = res.bits();
+    for (size_t i = 0; i < res.words(); ++i) {
+        w[i] = ~w[i];
     }
+    res.clearTail();
     return res;
 }
+
+bitflag& bitflag::operator|=(const bitflag& rhs)
+{
+    if (mSize < rhs.mSize) {
+        resize(rhs.mSize);
+    }
+    word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    for (size_t i = 0; i < rhs.words(); ++i) {
+        lhsWords[i] |= rhsWords[i];
+    }
+    return *this;
+}
+
+bitflag& bitflag::operator^=(const bitflag& rhs)
+{
+    if (mSize < rhs.mSize) {
+        resize(rhs.mSize);
+    }
+    word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    for (size_t i = 0; i < rhs.words(); ++i) {
+        lhsWords[i] ^= rhsWords[i];
+    }
+    return *this;
+}
+
+bitflag& bitflag::operator&=(const bitflag& rhs)
+{
+    word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    size_t common = std::min(words(), rhs.words());
+    for (size_t i = 0; i < common; ++i) {
+        lhsWords[i] &= rhsWords[i];
+    }
+    std::fill(lhsWords + common, lhsWords + words(), 0);
+    return *this;
+}
+
+bitflag& bitflag::and_not(const bitflag& rhs)
+{
+    word* lhsWords = bits();
+    const word* rhsWords = rhs.bits();
+    size_t common = std::min(words(), rhs.words());
+    for (size_t i = 0; i < common; ++i) {
+        lhsWords[i] &= ~rhsWords[i];
+    }
+    return *this;
+}
+
+size_t bitflag::find_next(size_t pos) const
+{
+    if (pos >= mSize) {
+        return mSize;
+    }
+
+    const word* w = bits();
+    size_t index = pos / WORD_BITS;
+    word current = w[index] & (~word(0) << (pos % WORD_BITS));
+    while (current == 0) {
+        if (++index == words()) {
+            return mSize;
+        }
+        current = w[index];
+    }
+    return index * WORD_BITS + countTrailingZeros(current);
+}
+
+size_t bitflag::hash() const
+{
+    const word* w = bits();
+    size_t used = words();
+    while (used > 0 && w[used - 1] == 0) {
+        --used;
+    }
+
+    size_t result = used;
+    for (size_t i = 0; i < used; ++i) {
+        result ^= std::hash<word>()(w[i]) + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+    }
+    return result;
+}
+
+bitflag operator|(bitflag lhs, const bitflag& rhs)
+{
+    return lhs |= rhs;
+}
+
+bitflag operator^(bitflag lhs, const bitflag& rhs)
+{
+    return lhs ^= rhs;
+}
+
+bitflag operator&(bitflag lhs, const bitflag& rhs)
+{
+    return lhs &= rhs;
+}
+
+void bitflag::grow(size_t size)
+{
+    size_t required = wordsFor(size);
+    if (required <= mCapacity) {
+        return;
+    }
+
+    word* grown = new word[required]();
+    std::copy(bits(), bits() + words(), grown);
+    if (!isInline()) {
+        delete[] mHeap;
+    }
+    mHeap = grown;
+    mCapacity = required;
+}
+
+void bitflag::take(bitflag& other)
+{
+    if (!isInline()) {
+        delete[] mHeap;
+    }
+
+    mSize = other.mSize;
+    mCapacity = other.mCapacity;
+    if (isInline()) {
+        std::copy(other.mInline, other.mInline + INLINE_WORDS, mInline);
+    } else {
+        mHeap = other.mHeap;
+    }
+
+    // moved-from bitflag is left empty
+    other.mSize = 0;
+    other.mCapacity = INLINE_WORDS;
+    std::fill(other.mInline, other.mInline + INLINE_WORDS, 0);
+}
+
+void bitflag::clearTail()
+{
+    size_t used = mSize % WORD_BITS;
+    if (used != 0) {
+        bits()[mSize / WORD_BITS] &= (word(1) << used) - 1;
+    }
+}
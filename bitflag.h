@@ -24,30 +24,90 @@
 
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
 #include <assert.h>
 #include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <ostream>
 
-struct bitflag_private;
-
+// Set of flags kept in 64-bit words. Up to INLINE_BITS flags are stored
+// inside the object, bigger sets spill to the heap. Flags beyond size()
+// are treated as disabled by every comparison.
 struct bitflag
 {
+    using word = uint64_t;
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t INLINE_WORDS = 2;
+    static constexpr size_t INLINE_BITS = INLINE_WORDS * WORD_BITS;
+
     bitflag(size_t size = 1);
     bitflag(const bitflag& other);
     bitflag(bitflag&& other);
     ~bitflag();
 
+    bitflag& operator=(const bitflag& other);
+    bitflag& operator=(bitflag&& other);
+
     bool at(size_t pos) const;
     void set(size_t pos, bool value);
     size_t size() const;
     void resize(size_t size);
     size_t enabled_flags_count() const;
+    // true if every flag enabled in rhs is enabled in this
     bool has(const bitflag& rhs) const;
+    // true if any flag is enabled in both
+    bool intersects(const bitflag& rhs) const;
+    bool operator==(const bitflag& rhs) const;
+    bool operator!=(const bitflag& rhs) const { return !(*this == rhs); }
     bitflag operator!() const;
 
+    // size of the result is the bigger of both sizes
+    bitflag& operator|=(const bitflag& rhs);
+    bitflag& operator^=(const bitflag& rhs);
+    // size is kept, flags beyond size of rhs get disabled
+    bitflag& operator&=(const bitflag& rhs);
+    // disables every flag enabled in rhs
+    bitflag& and_not(const bitflag& rhs);
+
+    // position of the first enabled flag not lower than pos, size() if none
+    size_t find_next(size_t pos) const;
+
+    // consistent with operator==, trailing disabled flags do not matter
+    size_t hash() const;
+
+    // enabled flags in ascending order
+    struct set_bits_range
+    {
+        struct iterator
+        {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = size_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const size_t*;
+            using reference = size_t;
+
+            size_t operator*() const { return pos; }
+            iterator& operator++() { pos = flags->find_next(pos + 1); return *this; }
+            bool operator==(const iterator& rhs) const { return pos == rhs.pos; }
+            bool operator!=(const iterator& rhs) const { return pos != rhs.pos; }
+
+            const bitflag* flags;
+            size_t pos;
+        };
+
+        iterator begin() const { return iterator{ flags, flags->find_next(0) }; }
+        iterator end() const { return iterator{ flags, flags->size() }; }
+
+        const bitflag* flags;
+    };
+
+    set_bits_range set_bits() const { return set_bits_range{ this }; }
+
     std::string str() const {
         std::stringstream ss;
         ss << *this;
@@ -62,5 +122,36 @@ struct bitflag
     }
 
 private:
-    std::unique_ptr<bitflag_private> data;
+    static size_t wordsFor(size_t bits) { return (bits + WORD_BITS - 1) / WORD_BITS; }
+    size_t words() const { return wordsFor(mSize); }
+    bool isInline() const { return mCapacity <= INLINE_WORDS; }
+    word* bits() { return isInline() ? mInline : mHeap; }
+    const word* bits() const { return isInline() ? mInline : mHeap; }
+    // takes over content of other which is left empty
+    void take(bitflag& other);
+    void clearTail();
+    void grow(size_t size);
+
+private:
+    size_t mSize;
+    size_t mCapacity; // in words
+    // words past size() up to the capacity are kept cleared
+    union
+    {
+        word mInline[INLINE_WORDS];
+        word* mHeap;
+    };
+};
+
+bitflag operator|(bitflag lhs, const bitflag& rhs);
+bitflag operator^(bitflag lhs, const bitflag& rhs);
+bitflag operator&(bitflag lhs, const bitflag& rhs);
+
+namespace std
+{
+template<>
+struct hash<bitflag>
+{
+    size_t operator()(const bitflag& bf) const { return bf.hash(); }
 };
+}
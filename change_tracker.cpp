@@ -0,0 +1,186 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "change_tracker.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "epoch.h"
+
+namespace ecs
+{
+constexpr size_t change_tracker::COMPACTION_THRESHOLD;
+constexpr size_t change_tracker::DEFAULT_HISTORY;
+
+change_tracker::change_tracker()
+    : mLogs(std::make_shared<log_table>())
+    , mPublishedLogs(mLogs.get())
+{
+}
+
+void change_tracker::track(component_tag tag, size_t history)
+{
+    std::lock_guard<std::mutex> lock(mLogsMutex);
+    if (tag < mLogs->size() && (*mLogs)[tag]) {
+        return;
+    }
+
+    log_table table = *mLogs;
+    if (table.size() <= tag) {
+        table.resize(tag + 1);
+    }
+    // changes made before are not known, so they cannot be asked about
+    table[tag] = std::make_shared<log>(std::max<size_t>(history, 2), mRevision.load());
+
+    auto previous = std::move(mLogs);
+    mLogs = std::make_shared<log_table>(std::move(table));
+    mPublishedLogs.store(mLogs.get(), std::memory_order_release);
+    // writers recording changes may still be reading the previous table
+    epoch::retire(new std::shared_ptr<const log_table>(std::move(previous)));
+}
+
+size_t change_tracker::revision() const
+{
+    return mRevision.load();
+}
+
+void change_tracker::record(component_tag tag, entity_id id)
+{
+    epoch::guard guard;
+    log* l = findLog(tag);
+    if (!l) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(l->mutex);
+    append(*l, id);
+}
+
+void change_tracker::record(component_tag tag, const storage::batch& components)
+{
+    epoch::guard guard;
+    log* l = findLog(tag);
+    if (!l) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(l->mutex);
+    for (const auto& entry : components) {
+        append(*l, entry.first);
+    }
+}
+
+void change_tracker::record(const bitflag& tags, entity_id id)
+{
+    for (size_t tag : tags.set_bits()) {
+        record(tag, id);
+    }
+}
+
+void change_tracker::forget(const bitflag& tags, entity_id id)
+{
+    epoch::guard guard;
+    for (size_t tag : tags.set_bits()) {
+        log* l = findLog(tag);
+        if (!l) {
+            continue;
+        }
+
+        // the entity is left in the changes until the next compaction,
+        // a destroyed entity is skipped when it is selected anyway
+        std::lock_guard<std::mutex> lock(l->mutex);
+        l->latest.erase(id);
+    }
+}
+
+bool change_tracker::changed_since(const bitflag& tags, size_t since, std::vector<entity_id>& entities) const
+{
+    epoch::guard guard;
+    size_t first = entities.size();
+    for (size_t tag : tags.set_bits()) {
+        log* l = findLog(tag);
+        if (!l) {
+            entities.resize(first);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(l->mutex);
+        if (since < l->horizon) {
+            entities.resize(first);
+            return false;
+        }
+        // changes are ordered by revision, newer ones are at the end
+        auto newer = std::upper_bound(l->changes.begin(), l->changes.end(), since,
+            [](size_t revision, const std::pair<size_t, entity_id>& change) { return revision < change.first; });
+        for (; newer != l->changes.end(); ++newer) {
+            entities.push_back(newer->second);
+        }
+    }
+
+    std::sort(entities.begin() + first, entities.end());
+    entities.erase(std::unique(entities.begin() + first, entities.end()), entities.end());
+    return true;
+}
+
+change_tracker::log* change_tracker::findLog(component_tag tag) const
+{
+    const log_table* table = mPublishedLogs.load(std::memory_order_acquire);
+    return tag < table->size() ? (*table)[tag].get() : nullptr;
+}
+
+void change_tracker::append(log& l, entity_id id)
+{
+    // taken under the lock of the log, so the log stays ordered
+    size_t revision = ++mRevision;
+    l.changes.emplace_back(revision, id);
+    l.latest[id] = revision;
+
+    bool redundant = l.changes.size() >= COMPACTION_THRESHOLD && l.changes.size() > 2 * l.latest.size();
+    if (redundant || l.changes.size() > l.history) {
+        compact(l);
+    }
+}
+
+void change_tracker::compact(log& l)
+{
+    l.changes.clear();
+    for (const auto& entry : l.latest) {
+        l.changes.emplace_back(entry.second, entry.first);
+    }
+    std::sort(l.changes.begin(), l.changes.end());
+
+    size_t kept = l.history / 2;
+    if (l.changes.size() <= kept) {
+        return;
+    }
+
+    // readers asking about older revisions get every entity instead
+    auto firstKept = l.changes.end() - kept;
+    for (auto forgotten = l.changes.begin(); forgotten != firstKept; ++forgotten) {
+        l.latest.erase(forgotten->second);
+    }
+    l.horizon = std::prev(firstKept)->first;
+    l.changes.erase(l.changes.begin(), firstKept);
+}
+} // namespace ecs
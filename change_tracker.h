@@ -0,0 +1,105 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bitflag.h"
+#include "component.h"
+#include "storage.h"
+
+namespace ecs
+{
+// Counts changes of components and remembers, per component type, which
+// entities were changed at which revision, so changes since a revision are
+// found without looking at untouched entities. Only types passed to track()
+// are followed, changes of the other ones cost a single atomic load.
+class change_tracker
+{
+public:
+    // logs are compacted once they are this long and hold twice as many
+    // changes as there are distinct entities in them
+    static constexpr size_t COMPACTION_THRESHOLD = 1024;
+    // default number of changes a log keeps before it forgets the oldest ones
+    static constexpr size_t DEFAULT_HISTORY = 1 << 16;
+
+    change_tracker();
+    change_tracker(const change_tracker&) = delete;
+    change_tracker& operator=(const change_tracker&) = delete;
+
+    // starts recording changes of 'tag', a log keeps at least half of
+    // 'history' latest changes. Does nothing if the tag is already tracked
+    void track(component_tag tag, size_t history = DEFAULT_HISTORY);
+
+    // revision of the latest recorded change, zero before the first one
+    size_t revision() const;
+
+    void record(component_tag tag, entity_id id);
+    void record(component_tag tag, const storage::batch& components);
+    // change of every component set in 'tags'
+    void record(const bitflag& tags, entity_id id);
+    // drops changes of a destroyed entity
+    void forget(const bitflag& tags, entity_id id);
+
+    // appends ids of entities with a component of any of 'tags' changed after
+    // revision 'since', in ascending order and without duplicates. Returns
+    // false, leaving 'entities' untouched, when a tag is not tracked or its
+    // log does not reach back to 'since'
+    bool changed_since(const bitflag& tags, size_t since, std::vector<entity_id>& entities) const;
+
+private:
+    // changes of a single type in ascending order of revisions
+    struct log
+    {
+        explicit log(size_t history, size_t horizon) : history(history), horizon(horizon) {}
+
+        std::mutex mutex;
+        const size_t history;
+        size_t horizon; // changes up to this revision are forgotten
+        std::vector<std::pair<size_t, entity_id>> changes;
+        std::unordered_map<entity_id, size_t> latest; // revision by entity
+    };
+    using log_table = std::vector<std::shared_ptr<log>>; // indexed by tag
+
+    // has to be called under epoch::guard, nullptr if the tag is not tracked
+    log* findLog(component_tag tag) const;
+    // has to be called with the mutex of the log locked
+    void append(log& l, entity_id id);
+    // leaves only the latest change of every entity and forgets the oldest
+    // ones above half of the history
+    static void compact(log& l);
+
+private:
+    std::atomic<size_t> mRevision{ 0 };
+    std::shared_ptr<const log_table> mLogs; // guarded by mLogsMutex
+    std::atomic<const log_table*> mPublishedLogs; // read under epoch::guard
+    std::mutex mLogsMutex;
+};
+} // namespace ecs
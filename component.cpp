@@ -26,7 +26,7 @@
 
 namespace ecs
 {
-component_tag component::mNextAvailableTag = 0;
+std::atomic<component_tag> component::mNextAvailableTag{ 0 };
 
 void component::clone_private_data(ecs::component_ptr c) const
 {
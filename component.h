@@ -24,7 +24,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <type_traits>
 
 namespace ecs
 {
@@ -35,31 +37,20 @@ using component_ptr = std::shared_ptr<component>;
 
 struct component
 {
-private:
-    template<class T>
-    struct RegisteredComponents {
-        static bool is_registered;
-        static component_tag tag;
-    };
-
 public:
     virtual ~component() = default;
 
+    // tags are dense, start from 1 and are assigned on first use of a type,
+    // const and non-const type share the same tag
     template<class T>
     static component_tag tag_t() {
-        assert(RegisteredComponents<T>::is_registered);
-        return RegisteredComponents<T>::tag;
-    }
-
-    template<class T>
-    void register_t() {
-        if (RegisteredComponents<T>::is_registered) {
-            return;
+        if constexpr (std::is_same<T, std::remove_cv_t<T>>::value) {
+            static const component_tag tag = mNextAvailableTag.fetch_add(1, std::memory_order_relaxed) + 1;
+            return tag;
+        }
+        else {
+            return tag_t<std::remove_cv_t<T>>();
         }
-        RegisteredComponents<T>::is_registered = true;
-        RegisteredComponents<T>::tag = ++mNextAvailableTag;
-        RegisteredComponents<const T>::is_registered = true;
-        RegisteredComponents<const T>::tag = mNextAvailableTag;
     }
 
     virtual component_tag tag() const = 0;
@@ -67,18 +58,14 @@ public:
 protected:
     void clone_private_data(component_ptr c) const;
 private:
-    static component_tag mNextAvailableTag;
+    static std::atomic<component_tag> mNextAvailableTag;
     size_t mRevision = 0;
     friend struct entity;
+    friend struct storage;
 };
 
-template<class T> bool component::RegisteredComponents<T>::is_registered = false;
-template<class T> component_tag component::RegisteredComponents<T>::tag = 0;
-
 #define ECS_COMPONENT(NAME) \
-NAME() { \
-    component::register_t<NAME>(); \
-} \
+NAME() = default; \
 ~NAME() override = default; \
 ecs::component_tag tag() const override { \
     return component::tag_t<NAME>(); \
@@ -24,101 +24,214 @@
 
 #include "entity.h"
 
+#include <cassert>
+#include <memory>
+
 namespace ecs
 {
-entity::entity(entity_id id) : mId(id), mBitflag(0)
+entity::entity(entity_id id)
+    : mId(id)
+    , mSlots(new slots{ bitflag(0), {} })
 {
 }
 
 entity::entity(const entity &other)
     : mId(other.mId)
-    , mBitflag(other.mBitflag)
-    , mResources(other.mResources)
 {
+    epoch::guard guard;
+    mSlots.store(new slots(*other.mSlots.load(std::memory_order_acquire)), std::memory_order_relaxed);
+}
+
+entity::~entity()
+{
+    delete mSlots.load(std::memory_order_relaxed);
 }
 
 bool entity::has(component_tag t) const
 {
-    std::unique_lock<std::mutex> lock(mMutex);
-    if (mBitflag.size() <= t) {
+    epoch::guard guard;
+    const bitflag& flags = mSlots.load(std::memory_order_acquire)->flags;
+    if (flags.size() <= t) {
         return false;
     }
 
-    return mBitflag.at(t);
+    return flags.at(t);
 }
 
 bool entity::has(const bitflag &bf) const
 {
-    std::unique_lock<std::mutex> lock(mMutex);
-    return mBitflag.has(bf);
+    epoch::guard guard;
+    return has_unsafely(bf);
+}
+
+bool entity::intersects(const bitflag &bf) const
+{
+    epoch::guard guard;
+    return intersects_unsafely(bf);
 }
 
 std::vector<component_const_ptr> entity::get(const bitflag &bf) const
 {
-    assert(bf.size() <= mBitflag.size());
     std::vector<component_const_ptr> result;
-    mMutex.lock();
-    auto resources = mResources;
-    mMutex.unlock();
-
-    for (size_t i=0; i<bf.size(); ++i)
-    {
-        if (bf.at(i)) {
-            result.push_back(resources.at(i));
-        }
+    result.reserve(bf.enabled_flags_count());
+    epoch::guard guard;
+    const slots* s = mSlots.load(std::memory_order_acquire);
+    assert(bf.size() <= s->flags.size());
+
+    for (size_t i : bf.set_bits()) {
+        result.push_back(s->resources.at(i));
     }
     return result;
 }
 
+component_const_ptr entity::get(component_tag t) const
+{
+    epoch::guard guard;
+    return get_unsafely(t);
+}
+
+bitflag entity::get_bitflag() const
+{
+    epoch::guard guard;
+    return get_bitflag_unsafely();
+}
+
+bool entity::has_unsafely(const bitflag &bf) const
+{
+    return mSlots.load(std::memory_order_acquire)->flags.has(bf);
+}
+
+bool entity::intersects_unsafely(const bitflag &bf) const
+{
+    return mSlots.load(std::memory_order_acquire)->flags.intersects(bf);
+}
+
+component_const_ptr entity::get_unsafely(component_tag t) const
+{
+    const slots* s = mSlots.load(std::memory_order_acquire);
+    if (s->flags.size() <= t) {
+        return nullptr;
+    }
+
+    return s->resources.at(t);
+}
+
+bitflag entity::get_bitflag_unsafely() const
+{
+    return mSlots.load(std::memory_order_acquire)->flags;
+}
+
 bool entity::insert(component_ptr comp)
 {
-    entity_id myId = id();
-    size_t s = mBitflag.size();
-    std::unique_lock<std::mutex> lock(mMutex);
-    if (mBitflag.size() <= comp->tag()) {
-        mBitflag.resize(comp->tag()+1);
-        mResources.resize(comp->tag() +1);
+    return modify([&comp](slots& s) { return insert_into(s, comp); });
+}
+
+bool entity::remove(component_tag tag)
+{
+    return modify([tag](slots& s) { return remove_from(s, tag); });
+}
+
+bool entity::update(component_ptr comp)
+{
+    // revision of the new component is bumped before it gets published,
+    // it is restored if the update is rejected
+    const size_t revision = comp->mRevision;
+    bool updated = modify([&comp, revision](slots& s) { return update_in(s, comp, revision); });
+
+    if (!updated) {
+        comp->mRevision = revision;
     }
+    return updated;
+}
+
+bool entity::insert_unsafely(component_ptr comp)
+{
+    return insert_into(unshared_slots(), comp);
+}
+
+bool entity::remove_unsafely(component_tag tag)
+{
+    return remove_from(unshared_slots(), tag);
+}
+
+bool entity::update_unsafely(component_ptr comp)
+{
+    return update_in(unshared_slots(), comp, comp->mRevision);
+}
 
-    if (mBitflag.at(comp->tag())) {
+bool entity::insert_into(slots& s, const component_ptr& comp)
+{
+    component_tag tag = comp->tag();
+    if (s.flags.size() <= tag) {
+        s.flags.resize(tag + 1);
+        s.resources.resize(tag + 1);
+    }
+
+    if (s.flags.at(tag)) {
         return false;
     }
 
-    mResources[comp->tag()] = comp;
-    mBitflag.set(comp->tag(), true);
+    s.resources[tag] = comp;
+    s.flags.set(tag, true);
     return true;
 }
 
-bool entity::remove(component_tag tag)
+bool entity::remove_from(slots& s, component_tag tag)
 {
-    std::unique_lock<std::mutex> lock(mMutex);
-    if (mBitflag.size() <= tag) {
+    if (s.flags.size() <= tag) {
         return false;
     }
-    if (!mBitflag.at(tag)) {
+    if (!s.flags.at(tag)) {
         return false;
     }
 
-    mResources[tag] = component_ptr();
-    mBitflag.set(tag, false);
+    s.resources[tag] = component_ptr();
+    s.flags.set(tag, false);
     return true;
 }
 
-bool entity::update(component_ptr comp)
+bool entity::update_in(slots& s, const component_ptr& comp, size_t revision)
 {
-    std::unique_lock<std::mutex> lock(mMutex);
-    if (mBitflag.size() <= comp->tag()) {
+    component_tag tag = comp->tag();
+    if (s.flags.size() <= tag) {
         return false;
     }
-    if (!mBitflag.at(comp->tag())) {
+    if (!s.flags.at(tag)) {
         return false;
     }
-    if (comp->mRevision != mResources.at(comp->tag())->mRevision) {
+    if (revision != s.resources.at(tag)->mRevision) {
         return false;
     }
 
-    ++comp->mRevision;
-    mResources[comp->tag()] = comp;
+    comp->mRevision = revision + 1;
+    s.resources[tag] = comp;
     return true;
 }
+
+entity::slots& entity::unshared_slots()
+{
+    // no reader can see the slots, so they are not copied
+    return *const_cast<slots*>(mSlots.load(std::memory_order_relaxed));
+}
+
+template<class Modification>
+bool entity::modify(Modification m)
+{
+    epoch::guard guard;
+    const slots* current = mSlots.load(std::memory_order_acquire);
+    while (true) {
+        auto modified = std::make_unique<slots>(*current);
+        if (!m(*modified)) {
+            return false;
+        }
+
+        // on failure current gets reloaded with slots of the other writer
+        if (mSlots.compare_exchange_weak(current, modified.get(),
+                std::memory_order_acq_rel, std::memory_order_acquire)) {
+            modified.release();
+            epoch::retire(const_cast<slots*>(current));
+            return true;
+        }
+    }
+}
 } // namespace ecs
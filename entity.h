@@ -24,56 +24,94 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
-#include <mutex>
 #include "bitflag.h"
 #include "component.h"
+#include "epoch.h"
 
 namespace ecs
 {
 using entity_id = size_t;
+// Readers never block, they load the current slot array under epoch::guard.
+// Writers copy the array, modify the copy and publish it with compare and
+// swap, the replaced array is reclaimed once no reader can see it.
 struct entity
 {
     entity(entity_id id);
     entity(const entity& other);
+    ~entity();
+    entity& operator=(const entity& other) = delete;
 
     entity_id id() const { return mId; }
     bool has(component_tag t) const;
     bool has(const bitflag& bf) const;
+    // true if the entity has any of the components set in bf
+    bool intersects(const bitflag& bf) const;
     std::vector<component_const_ptr> get(const bitflag& bf) const;
+    component_const_ptr get(component_tag t) const;
     bool insert(component_ptr comp);
     bool remove(component_tag tag);
     bool update(component_ptr comp);
-    const bitflag& get_bitflag() { return mBitflag; }
+    bitflag get_bitflag() const;
+
+    // variants for an entity no other thread can access, like a copy a storage
+    // has not published yet, they change its slots in place
+    bool insert_unsafely(component_ptr comp);
+    bool remove_unsafely(component_tag tag);
+    bool update_unsafely(component_ptr comp);
+
+    // readers skipping epoch::guard, for callers which already hold one or
+    // for an entity whose slots are not replaced while it is shared
+    bool has_unsafely(const bitflag& bf) const;
+    bool intersects_unsafely(const bitflag& bf) const;
+    component_const_ptr get_unsafely(component_tag t) const;
+    bitflag get_bitflag_unsafely() const;
 
     template<class... Ts>
     std::vector<component_const_ptr> get() const {
         std::vector<component_const_ptr> result;
-        mMutex.lock();
-        auto resources = mResources;
-        mMutex.unlock();
-        get_components<Ts...>(resources, result);
+        result.reserve(sizeof...(Ts));
+        epoch::guard guard;
+        get_components<Ts...>(mSlots.load(std::memory_order_acquire)->resources, result);
         return result;
     }
 
 private:
+    // never modified once published
+    struct slots
+    {
+        bitflag flags;
+        std::vector<component_ptr> resources;
+    };
+
+    static bool insert_into(slots& s, const component_ptr& comp);
+    static bool remove_from(slots& s, component_tag tag);
+    // 'revision' is the one comp had before any attempt to store it
+    static bool update_in(slots& s, const component_ptr& comp, size_t revision);
+
     template<class T>
-    static void get_components(std::vector<component_ptr> source, std::vector<component_const_ptr>& result)
+    static void get_components(const std::vector<component_ptr>& source, std::vector<component_const_ptr>& result)
     {
         result.push_back(source.at(component::tag_t<T>()));
     }
 
     template<class T1, class T2, class... Ts>
-    static void get_components(std::vector<component_ptr> source, std::vector<component_const_ptr>& result)
+    static void get_components(const std::vector<component_ptr>& source, std::vector<component_const_ptr>& result)
     {
         result.push_back(source.at(component::tag_t<T1>()));
         get_components<T2, Ts...>(source, result);
     }
 
+    // applies m to a copy of current slots and publishes it if m returns true,
+    // m is called again if another writer published its slots in the meantime
+    template<class Modification>
+    bool modify(Modification m);
+    // slots of an entity which is not shared yet
+    slots& unshared_slots();
+
 private:
     entity_id mId;
-    bitflag mBitflag;
-    std::vector<component_ptr> mResources;
-    mutable std::mutex mMutex;
+    std::atomic<const slots*> mSlots;
 };
 }
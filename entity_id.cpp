@@ -0,0 +1,75 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "entity_id.h"
+
+namespace ecs
+{
+entity_id entity_allocator::allocate()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mFreeIndices.empty()) {
+        entity_index index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+        return make_entity_id(index, mGenerations[index]);
+    }
+
+    entity_index index = static_cast<entity_index>(mGenerations.size());
+    mGenerations.push_back(0);
+    return make_entity_id(index, 0);
+}
+
+std::vector<entity_id> entity_allocator::allocate(size_t count)
+{
+    std::vector<entity_id> ids;
+    ids.reserve(count);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (ids.size() < count && !mFreeIndices.empty()) {
+        entity_index index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+        ids.push_back(make_entity_id(index, mGenerations[index]));
+    }
+
+    entity_index index = static_cast<entity_index>(mGenerations.size());
+    mGenerations.resize(mGenerations.size() + (count - ids.size()), 0);
+    while (ids.size() < count) {
+        ids.push_back(make_entity_id(index++, 0));
+    }
+    return ids;
+}
+
+bool entity_allocator::release(entity_id id)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    entity_index index = index_of(id);
+    if (index >= mGenerations.size() || mGenerations[index] != generation_of(id)) {
+        return false;
+    }
+
+    ++mGenerations[index];
+    mFreeIndices.push_back(index);
+    return true;
+}
+} // namespace ecs
@@ -0,0 +1,69 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ecs
+{
+// Entity id consists of an index of a slot, which is reused once the entity
+// is removed, and a generation telling apart consecutive owners of the slot.
+using entity_id = size_t;
+using entity_index = uint32_t;
+using entity_generation = uint32_t;
+
+inline entity_index index_of(entity_id id)
+{
+    return static_cast<entity_index>(id & 0xFFFFFFFFu);
+}
+
+inline entity_generation generation_of(entity_id id)
+{
+    return static_cast<entity_generation>(static_cast<uint64_t>(id) >> 32);
+}
+
+inline entity_id make_entity_id(entity_index index, entity_generation generation)
+{
+    return static_cast<entity_id>((static_cast<uint64_t>(generation) << 32) | index);
+}
+
+// Hands out entity ids of a single registry. Indices of released ids are
+// recycled first, so storages indexed by them stay dense.
+struct entity_allocator
+{
+    entity_id allocate();
+    std::vector<entity_id> allocate(size_t count);
+    // returns false for an id which has been released already
+    bool release(entity_id id);
+
+private:
+    std::vector<entity_generation> mGenerations; // current generation of every index
+    std::vector<entity_index> mFreeIndices;
+    std::mutex mMutex;
+};
+} // namespace ecs
@@ -0,0 +1,208 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "entity_map_storage.h"
+
+#include <algorithm>
+
+#include "epoch.h"
+
+namespace ecs
+{
+entity_map_storage::entity_map_storage()
+    : mCurrent(std::make_shared<version>(0, persistent_table<entity>()))
+    , mPublished(mCurrent.get())
+{
+}
+
+void entity_map_storage::create(entity_id id)
+{
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    publish(mCurrent->entities.set(index_of(id), std::make_shared<entity>(id)));
+}
+
+bool entity_map_storage::destroy(entity_id id, bitflag& components)
+{
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    const entity* e = find(mCurrent->entities, id);
+    if (!e) {
+        return false;
+    }
+
+    components = e->get_bitflag_unsafely();
+    publish(mCurrent->entities.erase(index_of(id)));
+    return true;
+}
+
+bool entity_map_storage::insert(entity_id id, component_ptr c)
+{
+    return modify(id, [&c](entity& e) { return e.insert_unsafely(c); });
+}
+
+bool entity_map_storage::update(entity_id id, component_ptr c)
+{
+    return modify(id, [&c](entity& e) { return e.update_unsafely(c); });
+}
+
+bool entity_map_storage::remove(entity_id id, component_tag tag)
+{
+    return modify(id, [tag](entity& e) { return e.remove_unsafely(tag); });
+}
+
+component_ptr entity_map_storage::get(entity_id id, component_tag tag) const
+{
+    epoch::guard guard;
+    const entity* e = find(mPublished.load(std::memory_order_acquire)->entities, id);
+    if (!e) {
+        return nullptr;
+    }
+    return std::const_pointer_cast<component>(e->get_unsafely(tag));
+}
+
+void entity_map_storage::create_many(const std::vector<entity_id>& ids)
+{
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    auto entities = mCurrent->entities;
+    for (entity_id id : ids) {
+        entities.put(index_of(id), std::make_shared<entity>(id));
+    }
+    publish(std::move(entities));
+}
+
+void entity_map_storage::insert_many(batch& components)
+{
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    auto entities = mCurrent->entities;
+    auto notInserted = std::remove_if(components.begin(), components.end(), [&entities](const auto& entry) {
+        const entity* e = find(entities, entry.first);
+        if (!e) {
+            return true;
+        }
+
+        auto modified = std::make_shared<entity>(*e);
+        if (!modified->insert_unsafely(entry.second)) {
+            return true;
+        }
+        entities.put(index_of(entry.first), std::move(modified));
+        return false;
+    });
+    components.erase(notInserted, components.end());
+
+    if (!components.empty()) {
+        publish(std::move(entities));
+    }
+}
+
+void entity_map_storage::collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+    std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const
+{
+    auto snapshot = pin();
+    // published entities are never modified, the pinned version keeps them alive
+    snapshot->entities.for_each([&](size_t, const entity& e) {
+        if (!e.has_unsafely(bf) || e.intersects_unsafely(excluded)) {
+            return;
+        }
+        entities.push_back(e.id());
+        for (component_tag tag : tags) {
+            components.push_back(e.get_unsafely(tag));
+        }
+    });
+}
+
+struct entity_map_storage::row_cursor : public storage::cursor
+{
+    row_cursor(std::shared_ptr<const version> snapshot, const bitflag& bf, const bitflag& excluded,
+        const std::vector<component_tag>& tags)
+        : mSnapshot(std::move(snapshot)), mBitflag(bf), mExcluded(excluded), mTags(tags) {}
+
+    bool next(entity_id& id, std::vector<component_const_ptr>& components) override {
+        while (const entity* e = mSnapshot->entities.find_next(mKey)) {
+            ++mKey;
+            if (!e->has_unsafely(mBitflag) || e->intersects_unsafely(mExcluded)) {
+                continue;
+            }
+            id = e->id();
+            for (size_t i = 0; i < mTags.size(); ++i) {
+                components[i] = e->get_unsafely(mTags[i]);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    std::shared_ptr<const version> mSnapshot;
+    const bitflag& mBitflag;
+    const bitflag& mExcluded;
+    const std::vector<component_tag>& mTags;
+    size_t mKey = 0;
+};
+
+std::unique_ptr<storage::cursor> entity_map_storage::open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const
+{
+    return std::make_unique<row_cursor>(pin(), bf, excluded, tags);
+}
+
+const entity* entity_map_storage::find(const persistent_table<entity>& entities, entity_id id)
+{
+    const entity* e = entities.find(index_of(id));
+    if (!e || e->id() != id) {
+        return nullptr;
+    }
+    return e;
+}
+
+std::shared_ptr<const entity_map_storage::version> entity_map_storage::pin() const
+{
+    epoch::guard guard;
+    return mPublished.load(std::memory_order_acquire)->shared_from_this();
+}
+
+void entity_map_storage::publish(persistent_table<entity> entities)
+{
+    auto previous = std::move(mCurrent);
+    mCurrent = std::make_shared<version>(previous->revision + 1, std::move(entities));
+    mPublished.store(mCurrent.get(), std::memory_order_release);
+    // lock-free readers may still be walking the previous version
+    epoch::retire(new std::shared_ptr<const version>(std::move(previous)));
+}
+
+template<class Modification>
+bool entity_map_storage::modify(entity_id id, Modification m)
+{
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    const entity* e = find(mCurrent->entities, id);
+    if (!e) {
+        return false;
+    }
+
+    // the copy stays private until it is published, so it is modified in place
+    auto modified = std::make_shared<entity>(*e);
+    if (!m(*modified)) {
+        return false;
+    }
+
+    publish(mCurrent->entities.set(index_of(id), std::move(modified)));
+    return true;
+}
+} // namespace ecs
@@ -0,0 +1,84 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "entity.h"
+#include "persistent_table.h"
+#include "storage.h"
+
+namespace ecs
+{
+// Default storage engine keeping versions of the whole set of entities
+// (multi-version concurrency control). Published entities are never modified,
+// every write produces a new entity and a new version of the table sharing
+// all the untouched parts with the previous one. Readers pin the current
+// version in constant time and read it without blocking writers, point reads
+// do not take any lock at all.
+struct entity_map_storage : public storage
+{
+    entity_map_storage();
+
+    void create(entity_id id) override;
+    bool destroy(entity_id id, bitflag& components) override;
+    bool insert(entity_id id, component_ptr c) override;
+    bool update(entity_id id, component_ptr c) override;
+    bool remove(entity_id id, component_tag tag) override;
+    component_ptr get(entity_id id, component_tag tag) const override;
+    void create_many(const std::vector<entity_id>& ids) override;
+    void insert_many(batch& components) override;
+    void collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+        std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const override;
+    std::unique_ptr<cursor> open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const override;
+
+private:
+    struct version : public std::enable_shared_from_this<version>
+    {
+        version(size_t revision, persistent_table<entity> entities)
+            : revision(revision), entities(std::move(entities)) {}
+
+        size_t revision;
+        persistent_table<entity> entities;
+    };
+
+    struct row_cursor;
+
+    // entities are kept under their index, stale ids are not found
+    static const entity* find(const persistent_table<entity>& entities, entity_id id);
+    std::shared_ptr<const version> pin() const;
+    // has to be called with mWriteMutex locked
+    void publish(persistent_table<entity> entities);
+    template<class Modification>
+    bool modify(entity_id id, Modification m);
+
+private:
+    std::shared_ptr<const version> mCurrent; // guarded by mWriteMutex
+    std::atomic<const version*> mPublished; // read by lock-free readers under epoch::guard
+    std::mutex mWriteMutex;
+};
+} // namespace ecs
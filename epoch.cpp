@@ -0,0 +1,214 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "epoch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t QUIESCENT = UINT64_MAX;
+constexpr size_t RECLAIM_THRESHOLD = 64;
+
+struct retired
+{
+    void* object;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+// record of a thread taking part in reclamation, never deallocated
+// before the end of the program but reused after its thread exits
+struct participant
+{
+    std::atomic<uint64_t> epoch { QUIESCENT };
+    std::atomic<bool> inUse { true };
+    size_t nesting = 0;
+    // objects retired by the thread, handed over to the domain in batches
+    std::vector<retired> pending;
+    participant* next = nullptr;
+};
+
+struct domain
+{
+    std::atomic<uint64_t> globalEpoch { 0 };
+    std::atomic<participant*> participants { nullptr };
+    std::mutex retiredMutex;
+    std::vector<retired> retiredObjects;
+
+    ~domain()
+    {
+        for (const auto& r : retiredObjects) {
+            r.deleter(r.object);
+        }
+        participant* p = participants.load();
+        while (p) {
+            for (const auto& r : p->pending) {
+                r.deleter(r.object);
+            }
+            participant* next = p->next;
+            delete p;
+            p = next;
+        }
+    }
+
+    // moves objects retired by a thread to the shared list, the epoch is
+    // advanced once for the whole batch. Returns objects safe to delete
+    std::vector<retired> handOver(participant& p)
+    {
+        // pairs with the fence of epoch::guard, objects have been unlinked by now
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(retiredMutex);
+        // readers which announce themselves from now on can not see the objects
+        uint64_t retiredAt = globalEpoch.fetch_add(1);
+        for (auto& r : p.pending) {
+            r.epoch = retiredAt;
+        }
+        retiredObjects.insert(retiredObjects.end(), p.pending.begin(), p.pending.end());
+        p.pending.clear();
+        return collectUnreachable();
+    }
+
+    participant* acquire()
+    {
+        for (participant* p = participants.load(); p; p = p->next) {
+            bool expected = false;
+            if (!p->inUse.load() && p->inUse.compare_exchange_strong(expected, true)) {
+                return p;
+            }
+        }
+
+        auto p = new participant();
+        p->next = participants.load();
+        while (!participants.compare_exchange_weak(p->next, p)) {}
+        return p;
+    }
+
+    uint64_t oldestActiveEpoch() const
+    {
+        uint64_t oldest = QUIESCENT;
+        for (participant* p = participants.load(); p; p = p->next) {
+            oldest = std::min(oldest, p->epoch.load());
+        }
+        return oldest;
+    }
+
+    // has to be called with retiredMutex locked, returns objects safe to delete
+    std::vector<retired> collectUnreachable()
+    {
+        uint64_t oldest = oldestActiveEpoch();
+        std::vector<retired> unreachable;
+        auto firstPending = std::partition(retiredObjects.begin(), retiredObjects.end(),
+            [oldest](const retired& r) { return r.epoch < oldest; });
+        unreachable.assign(retiredObjects.begin(), firstPending);
+        retiredObjects.erase(retiredObjects.begin(), firstPending);
+        return unreachable;
+    }
+};
+
+domain& instance()
+{
+    static domain d;
+    return d;
+}
+
+struct participant_handle
+{
+    participant_handle() : domainRef(instance()), self(domainRef.acquire()) {}
+    ~participant_handle() {
+        self->epoch.store(QUIESCENT);
+        if (!self->pending.empty()) {
+            for (const auto& r : domainRef.handOver(*self)) {
+                r.deleter(r.object);
+            }
+        }
+        self->inUse.store(false);
+    }
+
+    domain& domainRef;
+    participant* self;
+};
+
+participant& local()
+{
+    thread_local participant_handle handle;
+    return *handle.self;
+}
+}
+
+namespace ecs
+{
+epoch::guard::guard()
+{
+    participant& p = local();
+    if (p.nesting++ == 0) {
+        p.epoch.store(instance().globalEpoch.load());
+        // announcement has to be visible before any shared pointer is read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+epoch::guard::~guard()
+{
+    participant& p = local();
+    if (--p.nesting == 0) {
+        p.epoch.store(QUIESCENT, std::memory_order_release);
+    }
+}
+
+void epoch::retire(void* object, void (*deleter)(void*))
+{
+    participant& p = local();
+    // the epoch is stamped when the batch is handed over, which is later
+    // than the object got unlinked, so readers are never underestimated
+    p.pending.push_back(retired{ object, deleter, 0 });
+    if (p.pending.size() < RECLAIM_THRESHOLD) {
+        return;
+    }
+
+    for (const auto& r : instance().handOver(p)) {
+        r.deleter(r.object);
+    }
+}
+
+size_t epoch::reclaim()
+{
+    domain& d = instance();
+    std::vector<retired> unreachable = d.handOver(local());
+    size_t pending = 0;
+    {
+        std::unique_lock<std::mutex> lock(d.retiredMutex);
+        pending = d.retiredObjects.size();
+    }
+
+    for (const auto& r : unreachable) {
+        r.deleter(r.object);
+    }
+    return pending;
+}
+} // namespace ecs
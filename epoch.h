@@ -0,0 +1,60 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace ecs
+{
+// Epoch based reclamation of memory shared with lock-free readers.
+// Readers access shared objects only while holding epoch::guard. Writers unlink
+// an object first and then hand it over to epoch::retire, it gets deleted once
+// every reader which could have seen it has released its guard.
+class epoch
+{
+public:
+    struct guard
+    {
+        guard();
+        ~guard();
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    };
+
+    template<class T>
+    static void retire(T* object) {
+        retire(object, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // objects are buffered per thread and handed over in batches, so
+    // writers share the lock and advance the epoch only once per batch
+    static void retire(void* object, void (*deleter)(void*));
+
+    // hands over objects retired by the calling thread and deletes
+    // retired objects no reader can access anymore,
+    // returns number of objects which still have to wait
+    static size_t reclaim();
+};
+} // namespace ecs
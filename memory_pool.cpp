@@ -0,0 +1,272 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "memory_pool.h"
+
+#include <algorithm>
+
+namespace ecs
+{
+constexpr size_t memory_pool::GRANULARITY;
+constexpr size_t memory_pool::SIZE_CLASSES;
+constexpr size_t memory_pool::MAX_BLOCK_SIZE;
+constexpr size_t memory_pool::BLOCKS_PER_SLAB;
+constexpr size_t memory_pool::CACHE_BATCH;
+
+namespace
+{
+size_t classIndex(size_t bytes)
+{
+    return bytes == 0 ? 0 : (bytes - 1) / memory_pool::GRANULARITY;
+}
+
+uint64_t nextPoolId()
+{
+    static std::atomic<uint64_t> id{ 0 };
+    return id++;
+}
+
+// guards registration of thread caches in pools, never destroyed so that
+// pools destroyed with static objects can still use it
+std::mutex& cachesMutex()
+{
+    static std::mutex* m = new std::mutex();
+    return *m;
+}
+
+// set once caches of the thread are destroyed, blocks released later on,
+// e.g. by destructors of static objects, go straight to shared free lists
+thread_local bool cachesDestroyed = false;
+}
+
+struct memory_pool::thread_cache
+{
+    explicit thread_cache(memory_pool* pool) : pool(pool), poolId(pool->mId)
+    {
+        for (size_t i = 0; i < SIZE_CLASSES; ++i) {
+            lists[i] = nullptr;
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    memory_pool* pool; // nullptr once the pool is destroyed, guarded by cachesMutex
+    const uint64_t poolId;
+    free_block* lists[SIZE_CLASSES];
+    // changed only by the owning thread, read by statistics
+    std::atomic<size_t> counts[SIZE_CLASSES];
+};
+
+struct memory_pool::thread_caches
+{
+    ~thread_caches()
+    {
+        std::lock_guard<std::mutex> lock(cachesMutex());
+        for (auto& cache : caches) {
+            memory_pool* pool = cache->pool;
+            if (!pool) {
+                continue;
+            }
+            for (size_t i = 0; i < SIZE_CLASSES; ++i) {
+                pool->flush(*cache, i, cache->counts[i].load(std::memory_order_relaxed));
+            }
+            auto& registered = pool->mCaches;
+            registered.erase(std::remove(registered.begin(), registered.end(), cache.get()), registered.end());
+        }
+        cachesDestroyed = true;
+    }
+
+    std::vector<std::unique_ptr<thread_cache>> caches;
+    thread_cache* last = nullptr;
+};
+
+memory_pool::memory_pool()
+    : mId(nextPoolId())
+{
+}
+
+memory_pool::~memory_pool()
+{
+    // blocks cached by other threads are gone together with the slabs
+    std::lock_guard<std::mutex> lock(cachesMutex());
+    for (thread_cache* cache : mCaches) {
+        cache->pool = nullptr;
+    }
+}
+
+bool memory_pool::isPooled(size_t bytes, size_t alignment)
+{
+    return bytes <= MAX_BLOCK_SIZE && alignment <= GRANULARITY;
+}
+
+void* memory_pool::allocate(size_t bytes, size_t alignment)
+{
+    if (!isPooled(bytes, alignment)) {
+        mOversizedInUse.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    size_t index = classIndex(bytes);
+    thread_cache* cache = localCache();
+    if (!cache) {
+        size_class& sc = mClasses[index];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        if (sc.freeList == nullptr) {
+            grow(sc, (index + 1) * GRANULARITY);
+        }
+        free_block* block = sc.freeList;
+        sc.freeList = block->next;
+        --sc.freeCount;
+        return block;
+    }
+
+    if (cache->lists[index] == nullptr) {
+        refill(*cache, index);
+    }
+
+    free_block* block = cache->lists[index];
+    cache->lists[index] = block->next;
+    cache->counts[index].store(cache->counts[index].load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    return block;
+}
+
+void memory_pool::deallocate(void* p, size_t bytes, size_t alignment)
+{
+    if (!isPooled(bytes, alignment)) {
+        mOversizedInUse.fetch_sub(1, std::memory_order_relaxed);
+        ::operator delete(p, std::align_val_t(alignment));
+        return;
+    }
+
+    size_t index = classIndex(bytes);
+    thread_cache* cache = localCache();
+    auto block = static_cast<free_block*>(p);
+    if (!cache) {
+        size_class& sc = mClasses[index];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        block->next = sc.freeList;
+        sc.freeList = block;
+        ++sc.freeCount;
+        return;
+    }
+
+    block->next = cache->lists[index];
+    cache->lists[index] = block;
+    size_t cached = cache->counts[index].load(std::memory_order_relaxed) + 1;
+    cache->counts[index].store(cached, std::memory_order_relaxed);
+    if (cached >= 2 * CACHE_BATCH) {
+        flush(*cache, index, CACHE_BATCH);
+    }
+}
+
+memory_pool::stats memory_pool::statistics() const
+{
+    stats result;
+    std::lock_guard<std::mutex> cachesLock(cachesMutex());
+    for (size_t i = 0; i < SIZE_CLASSES; ++i) {
+        const size_class& sc = mClasses[i];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        size_t capacity = sc.slabs.size() * BLOCKS_PER_SLAB;
+        size_t free = sc.freeCount;
+        for (const thread_cache* cache : mCaches) {
+            free += cache->counts[i].load(std::memory_order_relaxed);
+        }
+        // counts of threads working meanwhile may be read at different moments
+        result.classes.push_back({ (i + 1) * GRANULARITY, capacity, capacity > free ? capacity - free : 0 });
+    }
+    result.oversized_in_use = mOversizedInUse.load(std::memory_order_relaxed);
+    return result;
+}
+
+void memory_pool::grow(size_class& sc, size_t blockSize)
+{
+    sc.slabs.emplace_back(new unsigned char[blockSize * BLOCKS_PER_SLAB]);
+    unsigned char* slab = sc.slabs.back().get();
+    for (size_t i = BLOCKS_PER_SLAB; i > 0; --i) {
+        auto block = reinterpret_cast<free_block*>(slab + (i - 1) * blockSize);
+        block->next = sc.freeList;
+        sc.freeList = block;
+    }
+    sc.freeCount += BLOCKS_PER_SLAB;
+}
+
+memory_pool::thread_cache* memory_pool::localCache()
+{
+    if (cachesDestroyed) {
+        return nullptr;
+    }
+
+    thread_local thread_caches local;
+    if (local.last && local.last->poolId == mId) {
+        return local.last;
+    }
+    for (auto& cache : local.caches) {
+        if (cache->poolId == mId) {
+            local.last = cache.get();
+            return local.last;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cachesMutex());
+    // caches of destroyed pools are dropped on the way
+    local.caches.erase(std::remove_if(local.caches.begin(), local.caches.end(),
+        [](const std::unique_ptr<thread_cache>& cache) { return cache->pool == nullptr; }), local.caches.end());
+    local.caches.push_back(std::make_unique<thread_cache>(this));
+    local.last = local.caches.back().get();
+    mCaches.push_back(local.last);
+    return local.last;
+}
+
+void memory_pool::refill(thread_cache& cache, size_t index)
+{
+    size_class& sc = mClasses[index];
+    std::lock_guard<std::mutex> lock(sc.mutex);
+    if (sc.freeList == nullptr) {
+        grow(sc, (index + 1) * GRANULARITY);
+    }
+
+    size_t moved = 0;
+    for (; moved < CACHE_BATCH && sc.freeList; ++moved) {
+        free_block* block = sc.freeList;
+        sc.freeList = block->next;
+        block->next = cache.lists[index];
+        cache.lists[index] = block;
+    }
+    sc.freeCount -= moved;
+    cache.counts[index].store(cache.counts[index].load(std::memory_order_relaxed) + moved, std::memory_order_relaxed);
+}
+
+void memory_pool::flush(thread_cache& cache, size_t index, size_t count)
+{
+    size_class& sc = mClasses[index];
+    std::lock_guard<std::mutex> lock(sc.mutex);
+    size_t moved = 0;
+    for (; moved < count && cache.lists[index]; ++moved) {
+        free_block* block = cache.lists[index];
+        cache.lists[index] = block->next;
+        block->next = sc.freeList;
+        sc.freeList = block;
+    }
+    sc.freeCount += moved;
+    cache.counts[index].store(cache.counts[index].load(std::memory_order_relaxed) - moved, std::memory_order_relaxed);
+}
+} // namespace ecs
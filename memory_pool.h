@@ -0,0 +1,146 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ecs
+{
+// Size-class pool for small, frequently replaced components. Blocks are
+// carved from slabs and recycled through per-class free lists, requests
+// larger than the biggest class go to the global allocator. Every thread
+// keeps its own short free lists and moves blocks from and to the shared
+// ones in batches, so threads rarely contend on a size class.
+class memory_pool
+{
+public:
+    static constexpr size_t GRANULARITY = alignof(std::max_align_t);
+    static constexpr size_t SIZE_CLASSES = 16;
+    static constexpr size_t MAX_BLOCK_SIZE = GRANULARITY * SIZE_CLASSES;
+    static constexpr size_t BLOCKS_PER_SLAB = 64;
+    // blocks moved at once between a thread cache and a shared free list,
+    // a thread caches at most twice as many of a size class
+    static constexpr size_t CACHE_BATCH = 32;
+
+    struct size_class_stats
+    {
+        size_t block_size = 0;
+        size_t capacity = 0;
+        size_t in_use = 0;
+    };
+
+    struct stats
+    {
+        std::vector<size_class_stats> classes;
+        size_t oversized_in_use = 0;
+    };
+
+    memory_pool();
+    ~memory_pool();
+    memory_pool(const memory_pool&) = delete;
+    memory_pool& operator=(const memory_pool&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* p, size_t bytes, size_t alignment);
+
+    stats statistics() const;
+
+private:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    struct size_class
+    {
+        mutable std::mutex mutex;
+        free_block* freeList = nullptr;
+        size_t freeCount = 0;
+        std::vector<std::unique_ptr<unsigned char[]>> slabs;
+    };
+
+    // free lists of a single thread for a single pool
+    struct thread_cache;
+    // caches of all pools used by a thread, flushed when the thread exits
+    struct thread_caches;
+
+    static bool isPooled(size_t bytes, size_t alignment);
+    void grow(size_class& sc, size_t blockSize);
+    // nullptr once the caches of the exiting thread are destroyed
+    thread_cache* localCache();
+    // moves a batch of blocks of size class 'index' between the thread cache
+    // and the shared free list
+    void refill(thread_cache& cache, size_t index);
+    void flush(thread_cache& cache, size_t index, size_t count);
+
+    size_class mClasses[SIZE_CLASSES];
+    std::atomic<size_t> mOversizedInUse{ 0 };
+    const uint64_t mId; // never reused, unlike the address of the pool
+    std::vector<thread_cache*> mCaches; // guarded by the global caches mutex
+};
+
+// allocator for std::allocate_shared, keeps the pool alive as long as
+// any object allocated from it
+template<class T>
+struct pool_allocator
+{
+    using value_type = T;
+
+    explicit pool_allocator(std::shared_ptr<memory_pool> pool) : mPool(std::move(pool)) {}
+
+    template<class U>
+    pool_allocator(const pool_allocator<U>& other) : mPool(other.mPool) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(mPool->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        mPool->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template<class U>
+    bool operator==(const pool_allocator<U>& other) const {
+        return mPool == other.mPool;
+    }
+
+    template<class U>
+    bool operator!=(const pool_allocator<U>& other) const {
+        return mPool != other.mPool;
+    }
+
+private:
+    std::shared_ptr<memory_pool> mPool;
+
+    template<class U>
+    friend struct pool_allocator;
+};
+} // namespace ecs
@@ -0,0 +1,118 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ecs
+{
+// Bounded lock-free queue for many producers and a single consumer. Every
+// slot carries a sequence number telling whether it waits for the producer of
+// a position or is already filled for the consumer (D. Vyukov's bounded queue).
+template<class T>
+class mpsc_queue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit mpsc_queue(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mMask = size - 1;
+        mSlots = std::make_unique<slot[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    size_t capacity() const { return mMask + 1; }
+
+    // value is moved from only when pushed, returns false if the queue is full
+    bool try_push(T& value)
+    {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        for (;;) {
+            slot& s = mSlots[pos & mMask];
+            size_t sequence = s.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (difference == 0) {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.value = std::move(value);
+                    s.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // consumer has not freed the slot from the previous lap yet
+                return false;
+            } else {
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // may be called only by the consumer
+    bool try_pop(T& value)
+    {
+        slot& s = mSlots[mHead & mMask];
+        if (s.sequence.load(std::memory_order_acquire) != mHead + 1) {
+            return false;
+        }
+        value = std::move(s.value);
+        // the slot is free for the producer of the next lap
+        s.sequence.store(mHead + mMask + 1, std::memory_order_release);
+        ++mHead;
+        return true;
+    }
+
+    // may be called only by the consumer, a position claimed by a producer
+    // which has not finished writing it yet makes the queue not empty
+    bool empty() const
+    {
+        return mTail.load(std::memory_order_acquire) == mHead;
+    }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<slot[]> mSlots;
+    size_t mMask;
+    // producers and the consumer work on separate cache lines
+    alignas(CACHE_LINE) std::atomic<size_t> mTail{ 0 };
+    alignas(CACHE_LINE) size_t mHead = 0; // consumer only
+};
+} // namespace ecs
@@ -24,6 +24,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 namespace ecs
 {
 
@@ -36,6 +40,25 @@ enum class operation_t
     removed
 };
 
+// set of operations made of operation_bit values
+using operation_set = unsigned;
+
+constexpr operation_set operation_bit(operation_t operation)
+{
+    return 1u << static_cast<unsigned>(operation);
+}
+
+constexpr operation_set ALL_OPERATIONS = operation_bit(operation_t::inserted)
+    | operation_bit(operation_t::updated) | operation_bit(operation_t::removed);
+
+// narrows a subscription down before any notification is built,
+// subscriptions scoped to entities are found by a hash lookup
+struct subscription_filter
+{
+    std::vector<entity_id> entities; // every entity if empty
+    operation_set operations = ALL_OPERATIONS;
+};
+
 template <class T>
 struct Notification
 {
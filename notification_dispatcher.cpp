@@ -0,0 +1,122 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "notification_dispatcher.h"
+
+#include <algorithm>
+
+namespace ecs
+{
+constexpr size_t notification_dispatcher::BATCH;
+
+notification_dispatcher::notification_dispatcher(size_t numOfThreads)
+{
+    numOfThreads = std::max<size_t>(numOfThreads, 1);
+    for (size_t i = 0; i < numOfThreads; ++i) {
+        mWorkers.emplace_back([this]() { work(); });
+    }
+}
+
+notification_dispatcher::~notification_dispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mCondition.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void notification_dispatcher::schedule(std::shared_ptr<mailbox> m)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReady.push_back(std::move(m));
+    }
+    mCondition.notify_one();
+}
+
+void notification_dispatcher::schedule_after(std::shared_ptr<mailbox> m, std::chrono::steady_clock::duration delay)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDelayed.emplace(std::chrono::steady_clock::now() + delay, std::move(m));
+    }
+    // a waiting worker has to look at the new deadline
+    mCondition.notify_one();
+}
+
+void notification_dispatcher::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return mReady.empty() && mBusy == 0; });
+}
+
+void notification_dispatcher::work()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        promoteDue();
+        if (mReady.empty()) {
+            if (mStopped) {
+                return;
+            }
+            if (mDelayed.empty()) {
+                mCondition.wait(lock);
+            } else {
+                mCondition.wait_until(lock, mDelayed.begin()->first);
+            }
+            continue;
+        }
+
+        auto m = std::move(mReady.front());
+        mReady.pop_front();
+        ++mBusy;
+        lock.unlock();
+
+        bool pending = m->drain(BATCH);
+
+        lock.lock();
+        --mBusy;
+        // mailboxes with more notifications go to the back, so a busy
+        // subscriber does not starve the others
+        if (pending) {
+            mReady.push_back(std::move(m));
+        }
+        else if (mReady.empty() && mBusy == 0) {
+            mIdle.notify_all();
+        }
+    }
+}
+
+void notification_dispatcher::promoteDue()
+{
+    auto now = std::chrono::steady_clock::now();
+    while (!mDelayed.empty() && (mStopped || mDelayed.begin()->first <= now)) {
+        mReady.push_back(std::move(mDelayed.begin()->second));
+        mDelayed.erase(mDelayed.begin());
+    }
+}
+} // namespace ecs
@@ -0,0 +1,316 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "notification.h"
+
+namespace ecs
+{
+// what happens when a writer finds the queue of a subscriber full
+enum class backpressure_t
+{
+    block,       // writer waits until the subscriber makes room
+    drop_oldest, // the oldest pending notification is discarded
+    coalesce     // pending notification of the same entity gets replaced, keeping
+                 // its insertion, writer waits if there is none to replace
+};
+
+struct delivery_options
+{
+    size_t capacity = 1024;
+    backpressure_t backpressure = backpressure_t::block;
+};
+
+struct batch_options
+{
+    // with zero batches are delivered only by registry::flush_notifications
+    std::chrono::milliseconds interval{ 0 };
+};
+
+// notifications pending for a single subscriber, drained by at most one
+// dispatcher thread at a time so the subscriber sees them in order
+class mailbox : public std::enable_shared_from_this<mailbox>
+{
+public:
+    virtual ~mailbox() = default;
+    // delivers up to max notifications, returns true if more are pending
+    virtual bool drain(size_t max) = 0;
+};
+
+// threads delivering notifications of asynchronous subscriptions
+class notification_dispatcher
+{
+public:
+    static constexpr size_t BATCH = 64;
+
+    explicit notification_dispatcher(size_t numOfThreads);
+    // pending notifications are delivered before the threads are joined
+    ~notification_dispatcher();
+
+    notification_dispatcher(const notification_dispatcher&) = delete;
+    notification_dispatcher& operator=(const notification_dispatcher&) = delete;
+
+    void schedule(std::shared_ptr<mailbox> m);
+    // mailbox gets drained once the delay passes
+    void schedule_after(std::shared_ptr<mailbox> m, std::chrono::steady_clock::duration delay);
+    // blocks until no mailbox is pending nor being drained,
+    // mailboxes scheduled for later are not waited for
+    void wait_idle();
+
+private:
+    void work();
+    // has to be called with mMutex locked, all delayed mailboxes are due once stopped
+    void promoteDue();
+
+    std::vector<std::thread> mWorkers;
+    std::deque<std::shared_ptr<mailbox>> mReady;
+    std::multimap<std::chrono::steady_clock::time_point, std::shared_ptr<mailbox>> mDelayed;
+    size_t mBusy = 0;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::condition_variable mIdle;
+    bool mStopped = false;
+};
+
+// replaces a pending notification of the same entity with a later one,
+// an entity inserted and then updated is still reported as inserted
+template<class T>
+void coalesce(Notification<T>& pending, Notification<T> notification)
+{
+    operation_t operation = pending.operation == operation_t::inserted
+        && notification.operation == operation_t::updated ? operation_t::inserted : notification.operation;
+    pending = std::move(notification);
+    pending.operation = operation;
+}
+
+template<class T>
+class notification_queue : public mailbox
+{
+public:
+    using callback_t = std::function<void(const Notification<T>&)>;
+
+    notification_queue(notification_dispatcher& dispatcher, callback_t callback, delivery_options options)
+        : mDispatcher(dispatcher), mCallback(std::move(callback)), mOptions(options)
+    {
+        mOptions.capacity = std::max<size_t>(mOptions.capacity, 1);
+    }
+
+    // does nothing once the queue is closed
+    void push(Notification<T> notification)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (;;) {
+            if (mClosed) {
+                return;
+            }
+            if (mOptions.backpressure == backpressure_t::coalesce) {
+                auto queued = mQueued.find(notification.entityId);
+                if (queued != mQueued.end()) {
+                    coalesce(mPending[queued->second - mFirst], std::move(notification));
+                    return;
+                }
+            }
+            if (mPending.size() < mOptions.capacity) {
+                break;
+            }
+            if (mOptions.backpressure == backpressure_t::drop_oldest) {
+                popFront();
+                break;
+            }
+            mSpace.wait(lock);
+        }
+
+        if (mOptions.backpressure == backpressure_t::coalesce) {
+            mQueued[notification.entityId] = mFirst + mPending.size();
+        }
+        mPending.push_back(std::move(notification));
+
+        bool schedule = !mScheduled;
+        mScheduled = true;
+        lock.unlock();
+        if (schedule) {
+            mDispatcher.schedule(shared_from_this());
+        }
+    }
+
+    // discards pending notifications and releases blocked writers,
+    // a notification being delivered at the moment still completes
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mClosed = true;
+            mPending.clear();
+            mQueued.clear();
+        }
+        mSpace.notify_all();
+    }
+
+    bool drain(size_t max) override
+    {
+        for (size_t i = 0; i < max; ++i) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (mPending.empty() || mClosed) {
+                mScheduled = false;
+                return false;
+            }
+            Notification<T> notification = std::move(mPending.front());
+            popFront();
+            lock.unlock();
+            mSpace.notify_one();
+
+            mCallback(notification);
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mPending.empty() || mClosed) {
+            mScheduled = false;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // has to be called with mMutex locked
+    void popFront()
+    {
+        if (mOptions.backpressure == backpressure_t::coalesce) {
+            mQueued.erase(mPending.front().entityId);
+        }
+        mPending.pop_front();
+        ++mFirst;
+    }
+
+private:
+    notification_dispatcher& mDispatcher;
+    callback_t mCallback;
+    delivery_options mOptions;
+    std::deque<Notification<T>> mPending;
+    size_t mFirst = 0; // sequence number of mPending.front()
+    std::unordered_map<entity_id, size_t> mQueued; // sequence number by entity, coalesce only
+    bool mScheduled = false; // set while a dispatcher thread owns the mailbox
+    bool mClosed = false;
+    std::mutex mMutex;
+    std::condition_variable mSpace;
+};
+// Notifications collected for a subscriber receiving them in batches. A later
+// notification of an entity replaces the pending one, but an entity inserted
+// and then updated within a batch is still reported as inserted.
+template<class T>
+class notification_batch : public mailbox
+{
+public:
+    using callback_t = std::function<void(const std::vector<Notification<T>>&)>;
+
+    // dispatcher is needed only if batches are delivered on interval
+    notification_batch(notification_dispatcher* dispatcher, callback_t callback, batch_options options)
+        : mDispatcher(dispatcher), mCallback(std::move(callback)), mOptions(options)
+    {}
+
+    // does nothing once the batch is closed
+    void push(Notification<T> notification)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mClosed) {
+            return;
+        }
+
+        auto queued = mIndex.find(notification.entityId);
+        if (queued == mIndex.end()) {
+            mIndex.emplace(notification.entityId, mPending.size());
+            mPending.push_back(std::move(notification));
+        } else {
+            coalesce(mPending[queued->second], std::move(notification));
+        }
+
+        bool schedule = mDispatcher && mOptions.interval.count() > 0 && !mScheduled;
+        mScheduled = mScheduled || schedule;
+        lock.unlock();
+        if (schedule) {
+            mDispatcher->schedule_after(shared_from_this(), mOptions.interval);
+        }
+    }
+
+    // delivers pending notifications on the calling thread, callback must not
+    // flush the batch it is called for
+    void flush()
+    {
+        std::lock_guard<std::mutex> delivery(mDeliveryMutex);
+        mDelivering.clear();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDelivering.swap(mPending);
+            mIndex.clear();
+        }
+
+        if (!mDelivering.empty()) {
+            mCallback(mDelivering);
+        }
+    }
+
+    // discards pending notifications, a batch being delivered still completes
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mPending.clear();
+        mIndex.clear();
+    }
+
+    bool drain(size_t) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mScheduled = false;
+        }
+        flush();
+        return false;
+    }
+
+private:
+    notification_dispatcher* mDispatcher;
+    callback_t mCallback;
+    batch_options mOptions;
+    std::vector<Notification<T>> mPending;
+    std::unordered_map<entity_id, size_t> mIndex; // position in mPending by entity
+    bool mScheduled = false; // set while a delivery on interval is due
+    bool mClosed = false;
+    std::mutex mMutex;
+    std::vector<Notification<T>> mDelivering; // guarded by mDeliveryMutex
+    std::mutex mDeliveryMutex; // keeps batches in order
+};
+} // namespace ecs
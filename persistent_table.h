@@ -0,0 +1,202 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <memory>
+
+namespace ecs
+{
+// Immutable radix tree mapping integer keys to shared values. Modifications
+// return a new table which shares all the untouched nodes with the old one,
+// so keeping an older version alive costs nothing but a reference.
+template<class T>
+class persistent_table
+{
+public:
+    using key_type = size_t;
+    using value_ptr = std::shared_ptr<const T>;
+
+    // pointer stays valid as long as this version of the table exists
+    const T* find(key_type key) const
+    {
+        if (!mRoot || key >= capacity(mLevels)) {
+            return nullptr;
+        }
+
+        const node* n = static_cast<const node*>(mRoot.get());
+        for (size_t level = mLevels - 1; level > 0; --level) {
+            n = static_cast<const node*>(n->slots[slot(key, level)].get());
+            if (!n) {
+                return nullptr;
+            }
+        }
+        return static_cast<const T*>(n->slots[slot(key, 0)].get());
+    }
+
+    persistent_table set(key_type key, value_ptr value) const
+    {
+        persistent_table result(*this);
+        result.put(key, std::move(value));
+        return result;
+    }
+
+    // Modifies this table in place. Only nodes shared with other versions are
+    // copied, so a batch of modifications copies each node at most once.
+    void put(key_type key, value_ptr value)
+    {
+        if (find(key)) {
+            --mSize;
+        }
+        if (value) {
+            ++mSize;
+        }
+
+        while (key >= capacity(mLevels)) {
+            if (mRoot) {
+                auto root = std::make_shared<node>();
+                root->slots[0] = std::move(mRoot);
+                mRoot = std::move(root);
+            }
+            ++mLevels;
+        }
+
+        assign(mRoot, mLevels - 1, key, std::move(value));
+    }
+
+    persistent_table erase(key_type key) const { return set(key, nullptr); }
+
+    size_t size() const { return mSize; }
+
+    // first value with a key not lower than 'key', which gets updated to the
+    // key of the found value
+    const T* find_next(key_type& key) const
+    {
+        if (!mRoot || key >= capacity(mLevels)) {
+            return nullptr;
+        }
+        return seek(static_cast<const node*>(mRoot.get()), mLevels - 1, 0, key, true);
+    }
+
+    // calls f(key, const T&) for every value in ascending order of keys
+    template<class F>
+    void for_each(F&& f) const
+    {
+        if (mRoot) {
+            visit(static_cast<const node*>(mRoot.get()), mLevels - 1, 0, f);
+        }
+    }
+
+private:
+    static constexpr size_t BITS = 5;
+    static constexpr size_t WIDTH = size_t(1) << BITS;
+
+    // slots of the lowest level keep values, slots of upper levels keep nodes
+    struct node
+    {
+        std::array<std::shared_ptr<const void>, WIDTH> slots;
+    };
+
+    static size_t slot(key_type key, size_t level)
+    {
+        return (key >> (level * BITS)) & (WIDTH - 1);
+    }
+
+    static key_type capacity(size_t levels)
+    {
+        if (levels * BITS >= sizeof(key_type) * 8) {
+            return static_cast<key_type>(-1);
+        }
+        return key_type(1) << (levels * BITS);
+    }
+
+    // nodes are always created as non-const, a node owned by nobody else
+    // can not be reached by any reader and may be modified directly
+    static node* own(std::shared_ptr<const void>& n)
+    {
+        if (!n) {
+            n = std::make_shared<node>();
+        } else if (n.use_count() > 1) {
+            n = std::make_shared<node>(*static_cast<const node*>(n.get()));
+        }
+        return const_cast<node*>(static_cast<const node*>(n.get()));
+    }
+
+    static void assign(std::shared_ptr<const void>& n, size_t level, key_type key, value_ptr value)
+    {
+        auto& target = own(n)->slots[slot(key, level)];
+        if (level == 0) {
+            target = std::move(value);
+        } else {
+            assign(target, level - 1, key, std::move(value));
+        }
+    }
+
+    // 'bounded' is set while the visited prefix equals the prefix of 'key'
+    static const T* seek(const node* n, size_t level, key_type prefix, key_type& key, bool bounded)
+    {
+        const size_t first = bounded ? slot(key, level) : 0;
+        for (size_t i = first; i < WIDTH; ++i) {
+            const void* s = n->slots[i].get();
+            if (!s) {
+                continue;
+            }
+
+            key_type k = prefix | (key_type(i) << (level * BITS));
+            if (level == 0) {
+                key = k;
+                return static_cast<const T*>(s);
+            }
+            if (const T* value = seek(static_cast<const node*>(s), level - 1, k, key, bounded && i == first)) {
+                return value;
+            }
+        }
+        return nullptr;
+    }
+
+    template<class F>
+    static void visit(const node* n, size_t level, key_type prefix, F& f)
+    {
+        for (size_t i = 0; i < WIDTH; ++i) {
+            const void* s = n->slots[i].get();
+            if (!s) {
+                continue;
+            }
+
+            key_type key = prefix | (key_type(i) << (level * BITS));
+            if (level == 0) {
+                f(key, *static_cast<const T*>(s));
+            } else {
+                visit(static_cast<const node*>(s), level - 1, key, f);
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<const void> mRoot;
+    size_t mLevels = 1;
+    size_t mSize = 0;
+};
+} // namespace ecs
@@ -0,0 +1,123 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "query_terms.h"
+#include "storage.h"
+
+namespace ecs
+{
+// Lazy counterpart of view. Entities having all of Ts are read from the
+// storage one by one while iterating, so leaving the loop early skips the
+// rest of them and memory use does not depend on the number of matches.
+// Iteration is single pass and the query must not outlive its registry.
+template<class... Ts>
+class query
+{
+public:
+    using value_type = std::tuple<entity_id, std::shared_ptr<const component_of_t<Ts>>...>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = typename query::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        explicit iterator(query* q = nullptr) : mQuery(q) {}
+
+        reference operator*() const { return mQuery->mCurrent; }
+        pointer operator->() const { return &mQuery->mCurrent; }
+
+        iterator& operator++() {
+            if (!mQuery->advance()) {
+                mQuery = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return mQuery == other.mQuery; }
+        bool operator!=(const iterator& other) const { return mQuery != other.mQuery; }
+
+    private:
+        query* mQuery;
+    };
+
+    explicit query(std::unique_ptr<storage::cursor> cursor)
+        : mCursor(std::move(cursor))
+        , mComponents(sizeof...(Ts))
+    {}
+
+    query(query&&) = default;
+    query& operator=(query&&) = default;
+
+    // the first call fetches the first match, later calls continue where
+    // the previous iteration stopped
+    iterator begin() {
+        if (!mStarted) {
+            mStarted = true;
+            mFinished = !advance();
+        }
+        return mFinished ? end() : iterator(this);
+    }
+
+    iterator end() { return iterator(); }
+
+private:
+    bool advance() {
+        entity_id id;
+        if (!mCursor->next(id, mComponents)) {
+            mFinished = true;
+            return false;
+        }
+        std::get<0>(mCurrent) = id;
+        assign(std::index_sequence_for<Ts...>());
+        return true;
+    }
+
+    template<size_t... Is>
+    void assign(std::index_sequence<Is...>) {
+        ((std::get<Is + 1>(mCurrent) = std::static_pointer_cast<const component_of_t<std::tuple_element_t<Is, std::tuple<Ts...>>>>(
+            std::move(mComponents[Is]))), ...);
+    }
+
+private:
+    std::unique_ptr<storage::cursor> mCursor;
+    std::vector<component_const_ptr> mComponents;
+    value_type mCurrent;
+    bool mStarted = false;
+    bool mFinished = false;
+};
+} // namespace ecs
@@ -0,0 +1,138 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include "bitflag.h"
+#include "component.h"
+
+namespace ecs
+{
+// Terms which may be used next to plain component types in select and query:
+// without<Ts...> skips entities having any of Ts, optional<T> gives access to
+// T when present (nullptr otherwise) without requiring it.
+template<class... Ts>
+struct without {};
+
+template<class T>
+struct optional {};
+
+template<class T>
+struct is_optional : std::false_type {};
+
+template<class T>
+struct is_optional<optional<T>> : std::true_type {};
+
+// component type read by a column term
+template<class T>
+struct component_of { using type = std::remove_cv_t<T>; };
+
+template<class T>
+struct component_of<optional<T>> { using type = std::remove_cv_t<T>; };
+
+template<class T>
+using component_of_t = typename component_of<T>::type;
+
+template<class... Ts>
+struct type_list {};
+
+template<class... Lists>
+struct concat { using type = type_list<>; };
+
+template<class... As>
+struct concat<type_list<As...>> { using type = type_list<As...>; };
+
+template<class... As, class... Bs, class... Rest>
+struct concat<type_list<As...>, type_list<Bs...>, Rest...> : concat<type_list<As..., Bs...>, Rest...> {};
+
+template<template<class...> class Target, class List>
+struct apply_list;
+
+template<template<class...> class Target, class... Ts>
+struct apply_list<Target, type_list<Ts...>> { using type = Target<Ts...>; };
+
+template<class T>
+struct term
+{
+    using required = type_list<T>;
+    using excluded = type_list<>;
+    using columns = type_list<T>;
+};
+
+template<class T>
+struct term<optional<T>>
+{
+    using required = type_list<>;
+    using excluded = type_list<>;
+    using columns = type_list<optional<T>>;
+};
+
+template<class... Ts>
+struct term<without<Ts...>>
+{
+    using required = type_list<>;
+    using excluded = type_list<Ts...>;
+    using columns = type_list<>;
+};
+
+// splits terms of a query into required and excluded components
+// and columns of the result
+template<class... Terms>
+struct terms
+{
+    using required = typename concat<typename term<Terms>::required...>::type;
+    using excluded = typename concat<typename term<Terms>::excluded...>::type;
+    using columns = typename concat<typename term<Terms>::columns...>::type;
+};
+
+// flags and tags of a list of components, computed once per list
+template<class List>
+struct component_set;
+
+template<class... Ts>
+struct component_set<type_list<Ts...>>
+{
+    static const bitflag& mask() {
+        static const bitflag result = [] {
+            bitflag bf;
+            for (component_tag tag : tags()) {
+                if (bf.size() <= tag) {
+                    bf.resize(tag + 1);
+                }
+                bf.set(tag, true);
+            }
+            return bf;
+        }();
+        return result;
+    }
+
+    static const std::vector<component_tag>& tags() {
+        static const std::vector<component_tag> result{ component::tag_t<component_of_t<Ts>>()... };
+        return result;
+    }
+};
+} // namespace ecs
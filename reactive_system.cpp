@@ -23,43 +23,136 @@
 
 #include "reactive_system.h"
 
+#include <algorithm>
 #include <thread>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <atomic>
 
+#include "backoff.h"
+#include "mpsc_queue.h"
+#include "work_stealing_executor.h"
+
 namespace ecs
 {
+namespace
+{
+// data of the system whose thread is the current one
+thread_local const void* runningSystem = nullptr;
+}
+
 struct reactive_system::reactive_system_data
 {
-    state_t mState = state_t::idle;
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+    // empty polls of the queue before the system thread parks
+    static constexpr size_t SPINS = 64;
+
+    std::atomic<state_t> mState{ state_t::idle };
+    // set from start until the system thread leaves main, also while paused
+    std::atomic<bool> mDraining{ false };
+    size_t mParallelism = 1;
+    std::unique_ptr<work_stealing_executor> mExecutor; // only with parallelism above one
     std::thread mSystemThread;
-    std::queue<std::unique_ptr<command>> mTasksQueue;
-    std::mutex mTasksQueueMutex;
+    mpsc_queue<std::unique_ptr<command>> mTasksQueue{ QUEUE_CAPACITY };
+    // tasks the system thread adds to itself, they cannot wait for free space
+    // in the ring as only that thread frees it. Used only by the system thread
+    std::deque<std::unique_ptr<command>> mLocalTasks;
+    bool mLocalTurn = false;
+    std::atomic<bool> mSleeping{ false };
+    std::mutex mSleepMutex;
     std::condition_variable mExpectantForTask;
+
+    // other threads wait while the ring is full, but only as long as
+    // the system thread drains it, otherwise the task is discarded
+    bool push(std::unique_ptr<command> task)
+    {
+        if (runningSystem == this) {
+            mLocalTasks.push_back(std::move(task));
+            return true;
+        }
+
+        backoff delay;
+        while (!mTasksQueue.try_push(task)) {
+            if (!mDraining.load() || mState.load() == state_t::stopped) {
+                return false;
+            }
+            delay.pause();
+        }
+
+        // pairs with the fence in park, either the system thread sees the task
+        // or this thread sees it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mExpectantForTask.notify_one();
+        }
+        return true;
+    }
+
+    // called only by the system thread, its own tasks take turns with
+    // the tasks of other threads
+    bool pop(std::unique_ptr<command>& task)
+    {
+        bool local = !mLocalTasks.empty() && (mLocalTurn || mTasksQueue.empty());
+        mLocalTurn = !mLocalTurn;
+        if (local) {
+            task = std::move(mLocalTasks.front());
+            mLocalTasks.pop_front();
+            return true;
+        }
+        return mTasksQueue.try_pop(task);
+    }
+
+    bool hasTask() const
+    {
+        return !mTasksQueue.empty() || !mLocalTasks.empty();
+    }
+
+    void park()
+    {
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        mExpectantForTask.wait(lock, [this]() {
+            return hasTask() || mState.load() == state_t::stopped;
+        });
+        mSleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void wakeUp()
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mExpectantForTask.notify_all();
+    }
 };
 
-reactive_system::reactive_system()
+constexpr size_t reactive_system::reactive_system_data::QUEUE_CAPACITY;
+constexpr size_t reactive_system::reactive_system_data::SPINS;
+
+reactive_system::reactive_system(size_t parallelism)
     : mData(std::make_shared<reactive_system_data>())
 {
+    mData->mParallelism = std::max<size_t>(parallelism, 1);
+    if (mData->mParallelism > 1) {
+        mData->mExecutor = std::make_unique<work_stealing_executor>(mData->mParallelism);
+    }
 }
 
 reactive_system::~reactive_system()
 {
-    if (state() == state_t::stopped) {
-        return;
-    }
-
     stop();
-    mData->mExpectantForTask.notify_one();
-
-    if (mData->mSystemThread.joinable()) {
-        join();
-    }
+    join();
 }
 
 void reactive_system::start()
 {
+    mData->mState = state_t::running;
+    if (mData->mExecutor) {
+        mData->mExecutor->start();
+        return;
+    }
+
+    mData->mDraining = true;
     mData->mSystemThread = std::thread([this] () {
         main();
     });
@@ -71,11 +164,24 @@ void reactive_system::pause()
 void reactive_system::stop()
 {
     mData->mState = state_t::stopped;
-    mData->mExpectantForTask.notify_one();
+    mData->wakeUp();
+    if (mData->mExecutor) {
+        mData->mExecutor->stop();
+    }
 }
+// does nothing if there is no thread to join, so it can be called again
 void reactive_system::join()
 {
-    mData->mSystemThread.join();
+    if (mData->mExecutor) {
+        mData->mExecutor->join();
+        // workers are gone like the system thread which sets idle leaving main
+        state_t stopped = state_t::stopped;
+        mData->mState.compare_exchange_strong(stopped, state_t::idle);
+        return;
+    }
+    if (mData->mSystemThread.joinable()) {
+        mData->mSystemThread.join();
+    }
 }
 
 reactive_system::state_t reactive_system::state()
@@ -83,12 +189,19 @@ reactive_system::state_t reactive_system::state()
     return mData->mState;
 }
 
-void reactive_system::add_task(std::unique_ptr<command> cc)
+size_t reactive_system::parallelism() const
+{
+    return mData->mParallelism;
+}
+
+bool reactive_system::add_task(std::unique_ptr<command> cc)
 {
-    mData->mTasksQueueMutex.lock();
-    mData->mTasksQueue.emplace(std::move(cc));
-    mData->mTasksQueueMutex.unlock();
-    mData->mExpectantForTask.notify_one();
+    if (mData->mExecutor) {
+        mData->mExecutor->submit(std::move(cc));
+        return true;
+    }
+
+    return mData->push(std::move(cc));
 }
 
 void reactive_system::waitForResume()
@@ -97,21 +210,28 @@ void reactive_system::waitForResume()
 
 void reactive_system::main()
 {
-    mData->mState = state_t::running;
-    while (true)
+    runningSystem = mData.get();
+    size_t idle = 0;
+    std::unique_ptr<command> task;
+    while (state() != state_t::stopped)
     {
-        {
-            std::unique_lock<std::mutex> lk(mData->mTasksQueueMutex);
-            mData->mExpectantForTask.wait(lk, [this] () -> bool {
-                return !mData->mTasksQueue.empty() || state() == state_t::stopped;
-            });
+        if (mData->pop(task)) {
+            idle = 0;
+            task->execute();
+            task.reset();
+            continue;
         }
 
-        if (state() == state_t::stopped) { break; }
+        if (++idle < reactive_system_data::SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
 
-        mData->mTasksQueue.front()->execute();
-        mData->mTasksQueue.pop();
+        idle = 0;
+        mData->park();
     }
+    runningSystem = nullptr;
     mData->mState = state_t::idle;
+    mData->mDraining = false;
 }
 }
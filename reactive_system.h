@@ -26,12 +26,15 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <cstddef>
 
 namespace ecs
 {
 
 struct command
 {
+    virtual ~command() = default;
+
     std::atomic<bool> is_stopped = false;
     virtual void execute() = 0;
 };
@@ -50,7 +53,9 @@ public: /* types definitions */
     };
 
 public: /* methods */
-    reactive_system();
+    // with parallelism above one tasks are run by that many workers of
+    // a work stealing executor, so they may run concurrently and out of order
+    explicit reactive_system(size_t parallelism = 1);
     virtual ~reactive_system();
 
     virtual void initialize() {}
@@ -60,9 +65,13 @@ public: /* methods */
     void stop();
     void join();
     state_t state();
+    size_t parallelism() const;
 
 protected:
-    void add_task(std::unique_ptr<command> cc);
+    // waits while the task queue is full, except when called by a task of this
+    // system. A task which does not fit while no system thread empties the queue,
+    // before start or once stopped, is discarded and false is returned
+    bool add_task(std::unique_ptr<command> cc);
     void waitForResume();
 
 private:
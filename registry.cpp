@@ -23,54 +23,101 @@
 
 #include "registry.h"
 
+#include <algorithm>
+#include <unordered_set>
+
+#include "archetype_storage.h"
+#include "entity_map_storage.h"
+#include "sharded_storage.h"
+#include "sparse_set_storage.h"
+
 namespace
 {
-ecs::entity_id nextAvailableEntityId = 0;
+std::unique_ptr<ecs::storage> makeStorage(ecs::storage_t type)
+{
+    switch (type) {
+    case ecs::storage_t::sparse_set:
+        return std::make_unique<ecs::sparse_set_storage>();
+    case ecs::storage_t::archetype:
+        return std::make_unique<ecs::archetype_storage>();
+    case ecs::storage_t::entity_map:
+    default:
+        return std::make_unique<ecs::entity_map_storage>();
+    }
+}
+
+std::unique_ptr<ecs::storage> makeStorage(ecs::storage_t type, size_t numOfShards)
+{
+    if (numOfShards <= 1) {
+        return makeStorage(type);
+    }
+
+    std::vector<std::unique_ptr<ecs::storage>> shards;
+    for (size_t i = 0; i < numOfShards; ++i) {
+        shards.push_back(makeStorage(type));
+    }
+    return std::make_unique<ecs::sharded_storage>(std::move(shards));
+}
 }
 
 namespace ecs
 {
 
-entity_id registry::createEntity()
+registry::registry(storage_t storage, size_t numOfShards, size_t numOfDispatcherThreads)
+    : mMemoryPool(std::make_shared<memory_pool>())
+    , mStorage(makeStorage(storage, numOfShards))
+    , mSubscriptions(std::make_shared<subscription_table>())
+    , mPublishedSubscriptions(mSubscriptions.get())
+    , mNumOfDispatcherThreads(numOfDispatcherThreads)
 {
-    std::unique_lock<std::mutex> lock(mAccessMutex);
-    mEntities.emplace(std::make_pair(nextAvailableEntityId,
-        std::make_shared<entity>(nextAvailableEntityId)));
-    return nextAvailableEntityId++;
 }
 
-bool registry::insertComponent(entity_id id, component_ptr c)
+memory_pool::stats registry::memory_statistics() const
 {
-    mAccessMutex.lock();
-    auto iter = mEntities.find(id);
-    if (iter == mEntities.end()) {
-        return false;
-    }
+    return mMemoryPool->statistics();
+}
 
-    auto e = iter->second;
-    mAccessMutex.unlock();
+entity_id registry::createEntity()
+{
+    entity_id id = mEntityAllocator.allocate();
+    mStorage->create(id);
+    return id;
+}
+
+std::vector<entity_id> registry::createEntities(size_t count)
+{
+    std::vector<entity_id> ids = mEntityAllocator.allocate(count);
+    mStorage->create_many(ids);
+    return ids;
+}
 
-    bool result = e->insert(c);
+bool registry::insertComponent(entity_id id, component_ptr c)
+{
+    bool result = mStorage->insert(id, c);
     if (result) {
+        mChanges.record(c->tag(), id);
         handleSubscriptions(operation_t::inserted, id, c);
     }
 
     return result;
 }
 
-bool registry::updateComponent(entity_id id, component_ptr c)
+size_t registry::insertComponents(component_tag tag, storage::batch& components)
 {
-    mAccessMutex.lock();
-    auto iter = mEntities.find(id);
-    if (iter == mEntities.end()) {
-        return false;
+    mStorage->insert_many(components);
+    if (!components.empty()) {
+        mChanges.record(tag, components);
+        handleSubscriptions(operation_t::inserted, tag, components);
     }
 
-    auto e = iter->second;
-    mAccessMutex.unlock();
+    return components.size();
+}
 
-    bool result = e->update(c);
+bool registry::updateComponent(entity_id id, component_ptr c)
+{
+    bool result = mStorage->update(id, c);
     if (result) {
+        mChanges.record(c->tag(), id);
         handleSubscriptions(operation_t::updated, id, c);
     }
 
@@ -79,112 +126,241 @@ bool registry::updateComponent(entity_id id, component_ptr c)
 
 bool registry::remove(entity_id id, component_tag tag)
 {
-    mAccessMutex.lock();
-    auto iter = mEntities.find(id);
-    if (iter == mEntities.end()) {
-        return false;
+    bool result = mStorage->remove(id, tag);
+    if (result) {
+        mChanges.record(tag, id);
     }
 
-    auto e = iter->second;
-    mAccessMutex.unlock();
-
-    return e->remove(tag);
+    return result;
 }
 
 void registry::removeSubscription(subscription_id id)
 {
+    auto matches = [id](const subscription_entry& entry) { return entry.id == id; };
+    auto contains = [&matches](const tag_subscriptions& subscriptions) {
+        if (std::any_of(subscriptions.all.begin(), subscriptions.all.end(), matches)) {
+            return true;
+        }
+        return std::any_of(subscriptions.byEntity.begin(), subscriptions.byEntity.end(), [&matches](const auto& scoped) {
+            return std::any_of(scoped.second.begin(), scoped.second.end(), matches);
+        });
+    };
+
     std::unique_lock<std::mutex> lock(mSubscriptionsMutex);
-    mSubscriptions.erase(id);
+    subscription_table table = *mSubscriptions;
+    for (auto& subscriptions : table) {
+        if (!subscriptions || !contains(*subscriptions)) {
+            continue;
+        }
+
+        std::shared_ptr<Subscription> removed;
+        auto erase = [&matches, &removed](subscription_list& list) {
+            auto found = std::find_if(list.begin(), list.end(), matches);
+            if (found != list.end()) {
+                removed = found->subscription;
+                list.erase(found);
+            }
+        };
+
+        auto modified = std::make_shared<tag_subscriptions>(*subscriptions);
+        erase(modified->all);
+        for (auto scoped = modified->byEntity.begin(); scoped != modified->byEntity.end();) {
+            erase(scoped->second);
+            scoped = scoped->second.empty() ? modified->byEntity.erase(scoped) : std::next(scoped);
+        }
+
+        bool empty = modified->all.empty() && modified->byEntity.empty();
+        subscriptions = empty ? nullptr : std::move(modified);
+        publishSubscriptions(std::move(table));
+        // writers which pinned the previous table may still hand it events
+        removed->close();
+        return;
+    }
 }
 
 bool registry::remove(entity_id id)
 {
-    std::unique_lock<std::mutex> lock(mAccessMutex);
-    auto iter = mEntities.find(id);
-    bool isNotExisting = iter == mEntities.end();
-
-    if (isNotExisting) {
+    bitflag bf(0);
+    if (!mStorage->destroy(id, bf)) {
         return false;
     }
-
-    bitflag bf = iter->second->get_bitflag();
-    mEntities.erase(iter);
-    lock.unlock();
+    mEntityAllocator.release(id);
+    mChanges.forget(bf, id);
 
     handleSubscriptionsOnEntityRemoval(id, bf);
 
     return true;
 }
 
-std::map<entity_id, entity> registry::cloneEntities() const
-{
-    std::map<entity_id, entity> clones;
-    mAccessMutex.lock();
-    for (auto it = mEntities.cbegin(); it != mEntities.end(); ++it)
-    {
-        clones.emplace(it->first, entity(*it->second));
-    }
-    mAccessMutex.unlock();
-    return clones;
-}
-
-registry::Unsubscriber registry::addSubscription(std::shared_ptr<registry::Subscription> s)
+registry::Unsubscriber registry::addSubscription(std::shared_ptr<registry::Subscription> s, subscription_filter filter)
 {
     std::unique_lock<std::mutex> lock(mSubscriptionsMutex);
     auto subscriptionId = mNextAvailableSubscriptionId++;
-    auto result = mSubscriptions.emplace(std::make_pair(subscriptionId, s));
+    subscription_table table = *mSubscriptions;
+    component_tag tag = s->tag();
+    if (table.size() <= tag) {
+        table.resize(tag + 1);
+    }
+
+    auto modified = table[tag] ? std::make_shared<tag_subscriptions>(*table[tag]) : std::make_shared<tag_subscriptions>();
+    subscription_entry entry{ subscriptionId, filter.operations, std::move(s) };
+    if (filter.entities.empty()) {
+        modified->all.push_back(std::move(entry));
+    }
+    for (entity_id id : filter.entities) {
+        auto& scoped = modified->byEntity[id];
+        if (scoped.empty() || scoped.back().id != subscriptionId) {
+            scoped.push_back(entry);
+        }
+    }
+    table[tag] = std::move(modified);
+    publishSubscriptions(std::move(table));
+
     return [subscriptionId, this]() {
         removeSubscription(subscriptionId);
     };
 }
 
-void registry::handleSubscriptions(operation_t operation, entity_id id, component_const_ptr c) const
+notification_dispatcher& registry::dispatcher()
 {
     std::unique_lock<std::mutex> lock(mSubscriptionsMutex);
-    auto copy = mSubscriptions;
-    lock.unlock();
-
-    for (auto iter = copy.begin(); iter != copy.end(); ++iter)
-    {
-        auto& s = iter->second;
-        s->handle(operation, id, c);
+    if (!mDispatcher) {
+        mDispatcher = std::make_unique<notification_dispatcher>(mNumOfDispatcherThreads);
     }
+    return *mDispatcher;
 }
 
-void registry::handleRemovalSubscriptions(entity_id id, component_tag tag)
+void registry::flush_notifications()
 {
     std::unique_lock<std::mutex> lock(mSubscriptionsMutex);
-    auto copy = mSubscriptions;
+    auto table = mSubscriptions;
+    notification_dispatcher* d = mDispatcher.get();
     lock.unlock();
 
-    for (auto iter = copy.begin(); iter != copy.end(); ++iter)
-    {
-        auto& s = iter->second;
-        s->handle_removal(id, tag);
+    // a subscription scoped to many entities is flushed once
+    std::unordered_set<subscription_id> flushed;
+    auto flush = [&flushed](const subscription_list& list) {
+        for (const auto& entry : list) {
+            if (flushed.insert(entry.id).second) {
+                entry.subscription->flush();
+            }
+        }
+    };
+    for (const auto& subscriptions : *table) {
+        if (!subscriptions) {
+            continue;
+        }
+        flush(subscriptions->all);
+        for (const auto& scoped : subscriptions->byEntity) {
+            flush(scoped.second);
+        }
+    }
+
+    if (d) {
+        d->wait_idle();
     }
 }
 
-void registry::handleSubscriptionsOnEntityRemoval(entity_id id, const bitflag& bf)
+std::shared_ptr<const registry::tag_subscriptions> registry::subscriptionsOf(component_tag tag) const
 {
-    if (bf.enabled_flags_count() == 0) {
+    epoch::guard guard;
+    const subscription_table* table = mPublishedSubscriptions.load(std::memory_order_acquire);
+    if (table->size() <= tag) {
+        return nullptr;
+    }
+    return (*table)[tag];
+}
+
+void registry::publishSubscriptions(subscription_table table)
+{
+    auto previous = std::move(mSubscriptions);
+    mSubscriptions = std::make_shared<subscription_table>(std::move(table));
+    mPublishedSubscriptions.store(mSubscriptions.get(), std::memory_order_release);
+    // dispatching writers may still be reading the previous table
+    epoch::retire(new std::shared_ptr<const subscription_table>(std::move(previous)));
+}
+
+void registry::handleSubscriptions(operation_t operation, entity_id id, component_const_ptr c) const
+{
+    auto subscriptions = subscriptionsOf(c->tag());
+    if (!subscriptions) {
         return;
     }
 
-    std::unique_lock<std::mutex> lock(mSubscriptionsMutex);
-    auto copy = mSubscriptions;
-    lock.unlock();
+    const operation_set bit = operation_bit(operation);
+    for (const auto& entry : subscriptions->all) {
+        if (entry.operations & bit) {
+            entry.subscription->handle(operation, id, c);
+        }
+    }
+
+    if (const subscription_list* scoped = subscriptions->scopedTo(id)) {
+        for (const auto& entry : *scoped) {
+            if (entry.operations & bit) {
+                entry.subscription->handle(operation, id, c);
+            }
+        }
+    }
+}
+
+void registry::handleSubscriptions(operation_t operation, component_tag tag, const storage::batch& components) const
+{
+    auto subscriptions = subscriptionsOf(tag);
+    if (!subscriptions) {
+        return;
+    }
+
+    const operation_set bit = operation_bit(operation);
+    for (const auto& entry : subscriptions->all) {
+        if (entry.operations & bit) {
+            entry.subscription->handle_many(operation, components);
+        }
+    }
 
-    for (size_t tag = 0; tag < bf.size(); ++tag) {
-        if (!bf.at(tag)) {
+    if (subscriptions->byEntity.empty()) {
+        return;
+    }
+    for (const auto& component : components) {
+        const subscription_list* scoped = subscriptions->scopedTo(component.first);
+        if (!scoped) {
             continue;
         }
+        for (const auto& entry : *scoped) {
+            if (entry.operations & bit) {
+                entry.subscription->handle(operation, component.first, component.second);
+            }
+        }
+    }
+}
 
-        for (auto iter = copy.begin(); iter != copy.end(); ++iter)
-        {
-            auto& s = iter->second;
-            s->handle_removal(id, tag);
+void registry::handleRemovalSubscriptions(entity_id id, component_tag tag)
+{
+    auto subscriptions = subscriptionsOf(tag);
+    if (!subscriptions) {
+        return;
+    }
+
+    const operation_set bit = operation_bit(operation_t::removed);
+    for (const auto& entry : subscriptions->all) {
+        if (entry.operations & bit) {
+            entry.subscription->handle_removal(id);
         }
     }
+
+    if (const subscription_list* scoped = subscriptions->scopedTo(id)) {
+        for (const auto& entry : *scoped) {
+            if (entry.operations & bit) {
+                entry.subscription->handle_removal(id);
+            }
+        }
+    }
+}
+
+void registry::handleSubscriptionsOnEntityRemoval(entity_id id, const bitflag& bf)
+{
+    for (size_t tag : bf.set_bits()) {
+        handleRemovalSubscriptions(id, tag);
+    }
 }
 
 } //
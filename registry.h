@@ -23,14 +23,23 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
-#include <map>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 
+#include "backoff.h"
+#include "change_tracker.h"
 #include "entity.h"
+#include "entity_id.h"
+#include "epoch.h"
+#include "memory_pool.h"
+#include "notification_dispatcher.h"
+#include "query.h"
+#include "storage.h"
 #include "view.h"
 #include "notification.h"
 
@@ -38,22 +47,77 @@ namespace ecs
 {
 struct registry
 {
+    // with more than one shard entities are split between independently
+    // locked storages of the given type. Dispatcher threads are started with
+    // the first asynchronous subscription
+    explicit registry(storage_t storage = storage_t::entity_map, size_t numOfShards = 1,
+        size_t numOfDispatcherThreads = 1);
+
     entity_id createEntity();
+    std::vector<entity_id> createEntities(size_t count);
 
     bool remove(entity_id);
 
     template<class T>
     bool insert(entity_id eid, T&& component) {
-        std::shared_ptr<T> cptr = std::make_shared<T>(std::move(component));
+        std::shared_ptr<T> cptr = makeComponent<T>(std::move(component));
         return insertComponent(eid, cptr);
     }
 
+    // inserts components given as a range of (entity_id, T) pairs, storage is
+    // locked and subscribers are notified once for the whole range.
+    // Returns number of inserted components.
+    template<class T, class Range>
+    size_t insert_many(Range&& components) {
+        using source_t = std::conditional_t<std::is_lvalue_reference<Range>::value, const T&, T&&>;
+        storage::batch batch;
+        for (auto&& entry : components) {
+            batch.emplace_back(entry.first, makeComponent<T>(static_cast<source_t>(entry.second)));
+        }
+        return insertComponents(component::tag_t<T>(), batch);
+    }
+
     template<class T>
     bool update(entity_id eid, T&& component) {
-        std::shared_ptr<T> cptr = std::make_shared<T>(std::move(component));
+        std::shared_ptr<T> cptr = makeComponent<T>(std::move(component));
         return updateComponent(eid, cptr);
     }
 
+    static constexpr size_t MODIFY_ATTEMPTS = 16;
+
+    // applies fn(T&) to a copy of the current component and stores it,
+    // on revision conflict the copy is refreshed and fn is applied again.
+    // The replaced version goes back to the memory pool of the registry once
+    // its last reader releases it, so the block is reused by the next copy.
+    // Returns false when the component does not exist or all attempts failed
+    template<class T, class F>
+    bool modify(entity_id eid, F&& fn, size_t maxAttempts = MODIFY_ATTEMPTS) {
+        std::shared_ptr<T> next;
+        backoff delay;
+        for (size_t attempt = 0; attempt < maxAttempts; ++attempt) {
+            std::shared_ptr<const T> current = select<T>(eid);
+            if (current == nullptr) {
+                break;
+            }
+
+            // a rejected copy was never published, it is refreshed in place
+            if (next == nullptr) {
+                next = makeComponent<T>(*current);
+            }
+            else {
+                *next = *current;
+            }
+
+            fn(*next);
+            if (updateComponent(eid, next)) {
+                return true;
+            }
+            delay.pause();
+        }
+
+        return false;
+    }
+
     template<class T>
     bool remove(entity_id eid) {
         bool result = remove(eid, component::tag_t<T>());
@@ -63,41 +127,76 @@ struct registry
         return result;
     };
 
+    // Ts may contain plain component types, optional<T> and without<Ts...>
+    template<class... Ts>
+    using view_t = typename apply_list<view, typename terms<Ts...>::columns>::type;
+
     template<class... Ts>
-    view<Ts...> select() const {
-        bitflag bf;
-        fillBitflag<Ts...>(bf);
+    using query_t = typename apply_list<ecs::query, typename terms<Ts...>::columns>::type;
 
+    template<class... Ts>
+    view_t<Ts...> select() const {
+        using selection = terms<Ts...>;
         std::vector<entity_id> entities;
         std::vector<component_const_ptr> components;
+        mStorage->collect(component_set<typename selection::required>::mask(),
+            component_set<typename selection::excluded>::mask(),
+            component_set<typename selection::columns>::tags(), entities, components);
+
+        return view_t<Ts...>(std::move(entities), std::move(components));
+    }
+
+    // lazy version of select, entities are read while iterating
+    template<class... Ts>
+    query_t<Ts...> query() const {
+        using selection = terms<Ts...>;
+        return query_t<Ts...>(mStorage->open(component_set<typename selection::required>::mask(),
+            component_set<typename selection::excluded>::mask(),
+            component_set<typename selection::columns>::tags()));
+    }
+
+    // starts tracking changes of components of types Ts for select_changed,
+    // changes made before or while it is called are not tracked. Every type
+    // keeps at least half of 'history' latest changes
+    template<class... Ts>
+    void track_changes(size_t history = change_tracker::DEFAULT_HISTORY) {
+        for (component_tag tag : component_set<type_list<Ts...>>::tags()) {
+            mChanges.track(tag, history);
+        }
+    }
+
+    // current value of the change counter, each insertion, update and removal
+    // of a component of a tracked type increments it. Read it before calling
+    // select_changed, so changes made in the meantime are not missed by the next call
+    size_t revision() const { return mChanges.revision(); }
 
-        auto clones = cloneEntities();
-        for (auto iter = clones.begin(); iter != clones.end(); ++iter)
-        {
-            const auto& e = iter->second;
-            if (!e.has(bf)) continue;
-            entities.push_back(iter->first);
-            collectData<Ts...>(e, components);
+    // select limited to entities which had a component of any type named in
+    // Ts, optional and excluded ones included, inserted, updated or removed
+    // after 'since_revision'. Entities which do not match Ts anymore are left out.
+    // When a type is not tracked or its history does not reach back to
+    // 'since_revision' it is the same as select
+    template<class... Ts>
+    view_t<Ts...> select_changed(size_t since_revision) const {
+        using selection = terms<Ts...>;
+        using tracked = typename concat<typename selection::columns, typename selection::excluded>::type;
+        std::vector<entity_id> candidates;
+        if (!mChanges.changed_since(component_set<tracked>::mask(), since_revision, candidates)) {
+            return select<Ts...>();
         }
 
-        return view<Ts...>(std::move(entities), std::move(components));
+        std::vector<entity_id> entities;
+        std::vector<component_const_ptr> components;
+        mStorage->collect_from(candidates, component_set<typename selection::required>::mask(),
+            component_set<typename selection::excluded>::mask(),
+            component_set<typename selection::columns>::tags(), entities, components);
+
+        return view_t<Ts...>(std::move(entities), std::move(components));
     }
 
     template<class T>
     std::shared_ptr<const T> select(entity_id id) const
     {
-        mAccessMutex.lock();
-        auto iter = mEntities.find(id);
-        if (iter == mEntities.end()) {
-            mAccessMutex.unlock();
-            return nullptr;
-        }
-        const auto e = *iter->second;
-        mAccessMutex.unlock();
-        if (!e.has(component::tag_t<T>())) {
-            return nullptr;
-        }
-        return std::static_pointer_cast<const T>(e.get<T>().front());
+        return std::static_pointer_cast<const T>(mStorage->get(id, component::tag_t<T>()));
     }
 
     // synchronization should be guaranteed by a user
@@ -114,32 +213,34 @@ struct registry
     template<class T>
     void finish_unsafe_update(entity_id id) const
     {
-        mAccessMutex.lock();
-        auto iter = mEntities.find(id);
-        if (iter == mEntities.end()) {
-            return;
-        }
-
-        auto e = iter->second;
-        auto c = e->get<T>().front();
-        mAccessMutex.unlock();
-
+        auto c = mStorage->get(id, component::tag_t<T>());
         if (c == nullptr) {
             return;
         }
 
+        mChanges.record(c->tag(), id);
         handleSubscriptions(operation_t::updated, id, c);
     }
 
+    // subscriptions are indexed by tag, handlers get only components of their tag
     struct Subscription
     {
+        virtual component_tag tag() const = 0;
         virtual void handle(operation_t operation, entity_id id, component_const_ptr c) const = 0;
-        virtual void handle_removal(entity_id id, component_tag tag) const = 0;
+        virtual void handle_many(operation_t operation, const storage::batch& components) const = 0;
+        virtual void handle_removal(entity_id id) const = 0;
+        // called once the subscription is removed
+        virtual void close() const {}
+        // delivers notifications held back by the subscription
+        virtual void flush() const {}
     };
 
     template<class T>
     using SubscriptionNotifFunc = std::function<void(const Notification<T>&)>;
 
+    template<class T>
+    using BatchNotifFunc = std::function<void(const std::vector<Notification<T>>&)>;
+
     template<class T>
     using PreconditionFunc = std::function<bool(const Notification<T>&)>;
 
@@ -150,11 +251,11 @@ struct registry
             : callback(cb), precondition(prec)
         {}
 
-        void handle(operation_t operation, entity_id id, component_const_ptr c) const {
-            if ( c->tag() != component::tag_t<T>() ) {
-                return;
-            }
+        component_tag tag() const {
+            return component::tag_t<T>();
+        }
 
+        void handle(operation_t operation, entity_id id, component_const_ptr c) const {
             Notification<T> notification {
                 operation,
                 id,
@@ -162,15 +263,25 @@ struct registry
             };
 
             if (precondition(notification)) {
-                callback(notification);
+                notify(notification);
             }
         }
 
-        void handle_removal(entity_id id, component_tag tag) const {
-            if (tag != component::tag_t<T>()) {
-                return;
+        void handle_many(operation_t operation, const storage::batch& components) const {
+            for (const auto& entry : components) {
+                Notification<T> notification {
+                    operation,
+                    entry.first,
+                    std::static_pointer_cast<const T>(entry.second)
+                };
+
+                if (precondition(notification)) {
+                    notify(notification);
+                }
             }
+        }
 
+        void handle_removal(entity_id id) const {
             Notification<T> notification{
                 operation_t::removed,
                 id,
@@ -178,14 +289,59 @@ struct registry
             };
 
             if (precondition(notification)) {
-                callback(notification);
+                notify(notification);
             }
         }
 
+        virtual void notify(const Notification<T>& notification) const {
+            callback(notification);
+        }
+
         SubscriptionNotifFunc<T> callback;
         PreconditionFunc<T> precondition;
     };
 
+    // precondition is checked by the writer, callback is called by a dispatcher thread
+    template<class T>
+    struct AsyncSubscriptionVariant : public SubscriptionVariant<T>
+    {
+        AsyncSubscriptionVariant(std::shared_ptr<notification_queue<T>> queue, PreconditionFunc<T> prec)
+            : SubscriptionVariant<T>(nullptr, prec), queue(std::move(queue))
+        {}
+
+        void notify(const Notification<T>& notification) const override {
+            queue->push(notification);
+        }
+
+        void close() const override {
+            queue->close();
+        }
+
+        std::shared_ptr<notification_queue<T>> queue;
+    };
+
+    template<class T>
+    struct BatchSubscriptionVariant : public SubscriptionVariant<T>
+    {
+        BatchSubscriptionVariant(std::shared_ptr<notification_batch<T>> batch, PreconditionFunc<T> prec)
+            : SubscriptionVariant<T>(nullptr, prec), batch(std::move(batch))
+        {}
+
+        void notify(const Notification<T>& notification) const override {
+            batch->push(notification);
+        }
+
+        void close() const override {
+            batch->close();
+        }
+
+        void flush() const override {
+            batch->flush();
+        }
+
+        std::shared_ptr<notification_batch<T>> batch;
+    };
+
     using Unsubscriber = std::function<void()>;
 
     template<class T>
@@ -197,47 +353,62 @@ struct registry
         return addSubscription(std::make_shared<SubscriptionVariant<T>>(callback, precondition));
     }
 
-private:
+    // precondition is called only for notifications passing the filter
     template<class T>
-    static void fillBitflag(bitflag& bf) {
-        if (bf.size() <= component::tag_t<T>()) {
-            bf.resize(component::tag_t<T>() + 1);
-        }
-        bf.set(component::tag_t<T>(), true);
-    }
-
-    template<class T1, class T2, class... Rest>
-    static void fillBitflag(bitflag& bf) {
-        if (bf.size() <= component::tag_t<T1>()) {
-            bf.resize(component::tag_t<T1>() + 1);
-        }
-        bf.set(component::tag_t<T1>(), true);
-        fillBitflag<T2, Rest...>(bf);
+    Unsubscriber subscribe(SubscriptionNotifFunc<T> callback, subscription_filter filter,
+        PreconditionFunc<T> precondition = [](const Notification<T>&) -> bool { return true; })
+    {
+        static_assert( !std::is_same<ecs::entity, T>::value );
+        static_assert( std::is_base_of<ecs::component, T>::value );
+        return addSubscription(std::make_shared<SubscriptionVariant<T>>(callback, precondition), std::move(filter));
     }
 
+    // Callback is called by dispatcher threads and does not delay writers, unless
+    // the queue of the subscription is full and its backpressure blocks them.
+    // A callback must not block on writes to its own full queue
     template<class T>
-    void collectData(const entity& entity,
-        std::vector<component_const_ptr>& components) const
+    Unsubscriber subscribe_async(SubscriptionNotifFunc<T> callback, delivery_options options = delivery_options(),
+        PreconditionFunc<T> precondition = [](const Notification<T>&) -> bool { return true; })
     {
-        auto vec = entity.get<T>();
-        components.insert(components.end(), vec.begin(), vec.end());
+        static_assert( !std::is_same<ecs::entity, T>::value );
+        static_assert( std::is_base_of<ecs::component, T>::value );
+        auto queue = std::make_shared<notification_queue<T>>(dispatcher(), callback, options);
+        return addSubscription(std::make_shared<AsyncSubscriptionVariant<T>>(std::move(queue), precondition));
     }
 
-    template<class T1, class T2, class... Rest>
-    void collectData(const entity& entity,
-        std::vector<component_const_ptr>& components) const
+    // Notifications are coalesced by entity and delivered together on the
+    // given interval by a dispatcher thread, or by flush_notifications
+    template<class T>
+    Unsubscriber subscribe_batched(BatchNotifFunc<T> callback, batch_options options = batch_options(),
+        PreconditionFunc<T> precondition = [](const Notification<T>&) -> bool { return true; })
     {
-        auto vec = entity.get<T1>();
-        components.insert(components.end(), vec.begin(), vec.end());
-        collectData<T2, Rest...>(entity, components);
+        static_assert( !std::is_same<ecs::entity, T>::value );
+        static_assert( std::is_base_of<ecs::component, T>::value );
+        notification_dispatcher* d = options.interval.count() > 0 ? &dispatcher() : nullptr;
+        auto batch = std::make_shared<notification_batch<T>>(d, callback, options);
+        return addSubscription(std::make_shared<BatchSubscriptionVariant<T>>(std::move(batch), precondition));
     }
 
-    std::map<entity_id, entity> cloneEntities() const;
+    // delivers pending batches on the calling thread and then blocks until
+    // asynchronous subscribers have been notified of everything queued so far
+    void flush_notifications();
+
+    // occupancy of the pool components of this registry are allocated from
+    memory_pool::stats memory_statistics() const;
+
+private:
+    template<class T, class... Args>
+    std::shared_ptr<T> makeComponent(Args&&... args) const {
+        return std::allocate_shared<T>(pool_allocator<T>(mMemoryPool), std::forward<Args>(args)...);
+    }
 
     bool insertComponent(entity_id, component_ptr);
+    size_t insertComponents(component_tag, storage::batch&);
     bool updateComponent(entity_id, component_ptr);
-    Unsubscriber addSubscription(std::shared_ptr<Subscription> s);
+    Unsubscriber addSubscription(std::shared_ptr<Subscription> s, subscription_filter filter = subscription_filter());
+    notification_dispatcher& dispatcher();
     void handleSubscriptions(operation_t operation, entity_id id, component_const_ptr c) const;
+    void handleSubscriptions(operation_t operation, component_tag tag, const storage::batch& components) const;
     void handleRemovalSubscriptions(entity_id id, component_tag tag);
     void handleSubscriptionsOnEntityRemoval(entity_id id, const bitflag& bf);
 
@@ -246,11 +417,52 @@ private:
     using subscription_id = size_t;
     void removeSubscription(subscription_id);
 
+    struct subscription_entry
+    {
+        subscription_id id;
+        operation_set operations;
+        std::shared_ptr<Subscription> subscription;
+    };
+
+    using subscription_list = std::vector<subscription_entry>;
+
+    // subscriptions of a single tag, the ones scoped to entities are kept
+    // under each of their entities
+    struct tag_subscriptions
+    {
+        subscription_list all;
+        std::unordered_map<entity_id, subscription_list> byEntity;
+
+        const subscription_list* scopedTo(entity_id id) const {
+            if (byEntity.empty()) {
+                return nullptr;
+            }
+            auto found = byEntity.find(id);
+            return found == byEntity.end() ? nullptr : &found->second;
+        }
+    };
+
+    // indexed by component tag, entries are shared between versions of the table
+    using subscription_table = std::vector<std::shared_ptr<const tag_subscriptions>>;
+
+    // current subscriptions of the tag, never blocks
+    std::shared_ptr<const tag_subscriptions> subscriptionsOf(component_tag tag) const;
+    // has to be called with mSubscriptionsMutex locked
+    void publishSubscriptions(subscription_table table);
+
 private:
     subscription_id mNextAvailableSubscriptionId = 0;
-    std::map<entity_id, std::shared_ptr<entity>> mEntities;
-    std::map<subscription_id, std::shared_ptr<Subscription>> mSubscriptions;
-    mutable std::mutex mAccessMutex;
-    mutable std::mutex mSubscriptionsMutex;
+    entity_allocator mEntityAllocator;
+    std::shared_ptr<memory_pool> mMemoryPool;
+    std::unique_ptr<storage> mStorage;
+    // mutable as finish_unsafe_update records changes too
+    mutable change_tracker mChanges;
+    std::shared_ptr<const subscription_table> mSubscriptions; // guarded by mSubscriptionsMutex
+    std::atomic<const subscription_table*> mPublishedSubscriptions; // read under epoch::guard
+    std::mutex mSubscriptionsMutex;
+    size_t mNumOfDispatcherThreads;
+    // destroyed first, so pending notifications are delivered while
+    // subscriptions are still alive
+    std::unique_ptr<notification_dispatcher> mDispatcher; // created under mSubscriptionsMutex
 };
 } // namespace ecs
@@ -0,0 +1,137 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "sharded_storage.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace ecs
+{
+sharded_storage::sharded_storage(std::vector<std::unique_ptr<storage>> shards)
+    : mShards(std::move(shards))
+{
+    assert(!mShards.empty());
+}
+
+void sharded_storage::create(entity_id id)
+{
+    shard(id).create(id);
+}
+
+bool sharded_storage::destroy(entity_id id, bitflag& components)
+{
+    return shard(id).destroy(id, components);
+}
+
+bool sharded_storage::insert(entity_id id, component_ptr c)
+{
+    return shard(id).insert(id, std::move(c));
+}
+
+bool sharded_storage::update(entity_id id, component_ptr c)
+{
+    return shard(id).update(id, std::move(c));
+}
+
+bool sharded_storage::remove(entity_id id, component_tag tag)
+{
+    return shard(id).remove(id, tag);
+}
+
+component_ptr sharded_storage::get(entity_id id, component_tag tag) const
+{
+    return shard(id).get(id, tag);
+}
+
+void sharded_storage::create_many(const std::vector<entity_id>& ids)
+{
+    std::vector<std::vector<entity_id>> perShard(mShards.size());
+    for (entity_id id : ids) {
+        perShard[shardIndex(id)].push_back(id);
+    }
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        if (!perShard[i].empty()) {
+            mShards[i]->create_many(perShard[i]);
+        }
+    }
+}
+
+void sharded_storage::insert_many(batch& components)
+{
+    std::vector<batch> perShard(mShards.size());
+    for (auto& entry : components) {
+        perShard[shardIndex(entry.first)].push_back(std::move(entry));
+    }
+
+    components.clear();
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        if (perShard[i].empty()) {
+            continue;
+        }
+        mShards[i]->insert_many(perShard[i]);
+        std::move(perShard[i].begin(), perShard[i].end(), std::back_inserter(components));
+    }
+}
+
+void sharded_storage::collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+    std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const
+{
+    for (const auto& s : mShards) {
+        s->collect(bf, excluded, tags, entities, components);
+    }
+}
+
+struct sharded_storage::row_cursor : public storage::cursor
+{
+    row_cursor(const sharded_storage& owner, const bitflag& bf, const bitflag& excluded,
+        const std::vector<component_tag>& tags)
+        : mOwner(owner), mBitflag(bf), mExcluded(excluded), mTags(tags) {}
+
+    // shards are opened one after another
+    bool next(entity_id& id, std::vector<component_const_ptr>& components) override {
+        for (;;) {
+            if (mCurrent && mCurrent->next(id, components)) {
+                return true;
+            }
+            if (mShard == mOwner.mShards.size()) {
+                return false;
+            }
+            mCurrent = mOwner.mShards[mShard++]->open(mBitflag, mExcluded, mTags);
+        }
+    }
+
+    const sharded_storage& mOwner;
+    const bitflag& mBitflag;
+    const bitflag& mExcluded;
+    const std::vector<component_tag>& mTags;
+    std::unique_ptr<storage::cursor> mCurrent;
+    size_t mShard = 0;
+};
+
+std::unique_ptr<storage::cursor> sharded_storage::open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const
+{
+    return std::make_unique<row_cursor>(*this, bf, excluded, tags);
+}
+} // namespace ecs
@@ -0,0 +1,62 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "storage.h"
+
+namespace ecs
+{
+// Splits entities between independently locked storages chosen by entity id,
+// so writers touching different entities rarely wait for each other.
+// Operations spanning all the entities fan out over every shard.
+struct sharded_storage : public storage
+{
+    explicit sharded_storage(std::vector<std::unique_ptr<storage>> shards);
+
+    void create(entity_id id) override;
+    bool destroy(entity_id id, bitflag& components) override;
+    bool insert(entity_id id, component_ptr c) override;
+    bool update(entity_id id, component_ptr c) override;
+    bool remove(entity_id id, component_tag tag) override;
+    component_ptr get(entity_id id, component_tag tag) const override;
+    void create_many(const std::vector<entity_id>& ids) override;
+    void insert_many(batch& components) override;
+    void collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+        std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const override;
+    std::unique_ptr<cursor> open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const override;
+
+private:
+    struct row_cursor;
+
+    size_t shardIndex(entity_id id) const { return index_of(id) % mShards.size(); }
+    storage& shard(entity_id id) const { return *mShards[shardIndex(id)]; }
+
+private:
+    std::vector<std::unique_ptr<storage>> mShards;
+};
+} // namespace ecs
@@ -0,0 +1,355 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "sparse_set_storage.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace ecs
+{
+size_t* sparse_set::slot(entity_id id) const
+{
+    entity_index index = index_of(id);
+    size_t page = index / PAGE_SIZE;
+    if (page >= mSparse.size() || !mSparse[page]) {
+        return nullptr;
+    }
+    return &mSparse[page][index % PAGE_SIZE];
+}
+
+bool sparse_set::contains(entity_id id) const
+{
+    size_t* s = slot(id);
+    return s && *s != 0 && mDense[*s - 1] == id;
+}
+
+size_t sparse_set::index(entity_id id) const
+{
+    assert(contains(id));
+    return *slot(id) - 1;
+}
+
+bool sparse_set::insert(entity_id id)
+{
+    size_t* s = slot(id);
+    if (s && *s != 0) {
+        // slot is taken by this or another generation of the entity
+        return false;
+    }
+
+    entity_index index = index_of(id);
+    size_t page = index / PAGE_SIZE;
+    if (page >= mSparse.size()) {
+        mSparse.resize(page + 1);
+    }
+    if (!mSparse[page]) {
+        mSparse[page] = std::make_unique<size_t[]>(PAGE_SIZE);
+    }
+
+    mDense.push_back(id);
+    mSparse[page][index % PAGE_SIZE] = mDense.size();
+    return true;
+}
+
+size_t sparse_set::erase(entity_id id)
+{
+    size_t* removed = slot(id);
+    size_t position = *removed - 1;
+    entity_id last = mDense.back();
+    mDense[position] = last;
+    *slot(last) = position + 1;
+    *removed = 0;
+    mDense.pop_back();
+    return position;
+}
+
+component_ptr component_pool::get(entity_id id) const
+{
+    if (!mEntities.contains(id)) {
+        return nullptr;
+    }
+    return mComponents[mEntities.index(id)];
+}
+
+bool component_pool::insert(entity_id id, component_ptr c)
+{
+    if (!mEntities.insert(id)) {
+        return false;
+    }
+    mComponents.push_back(std::move(c));
+    return true;
+}
+
+void component_pool::replace(entity_id id, component_ptr c)
+{
+    mComponents[mEntities.index(id)] = std::move(c);
+}
+
+void component_pool::reserve(size_t capacity)
+{
+    mEntities.reserve(capacity);
+    mComponents.reserve(capacity);
+}
+
+bool component_pool::erase(entity_id id)
+{
+    if (!mEntities.contains(id)) {
+        return false;
+    }
+
+    size_t position = mEntities.erase(id);
+    mComponents[position] = std::move(mComponents.back());
+    mComponents.pop_back();
+    return true;
+}
+
+void sparse_set_storage::create(entity_id id)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mEntities.insert(id);
+}
+
+bool sparse_set_storage::destroy(entity_id id, bitflag& components)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mEntities.contains(id)) {
+        return false;
+    }
+
+    mEntities.erase(id);
+    components.resize(mPools.size());
+    for (size_t tag = 0; tag < mPools.size(); ++tag) {
+        if (mPools[tag] && mPools[tag]->erase(id)) {
+            components.set(tag, true);
+        }
+    }
+    return true;
+}
+
+bool sparse_set_storage::insert(entity_id id, component_ptr c)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return attach(id, std::move(c));
+}
+
+bool sparse_set_storage::update(entity_id id, component_ptr c)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    component_pool* p = pool(c->tag());
+    if (!p || !p->contains(id)) {
+        return false;
+    }
+    if (!accept_revision(*p->get(id), *c)) {
+        return false;
+    }
+
+    p->replace(id, std::move(c));
+    return true;
+}
+
+bool sparse_set_storage::remove(entity_id id, component_tag tag)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    component_pool* p = pool(tag);
+    return p && p->erase(id);
+}
+
+component_ptr sparse_set_storage::get(entity_id id, component_tag tag) const
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    component_pool* p = pool(tag);
+    if (!p) {
+        return nullptr;
+    }
+    return p->get(id);
+}
+
+void sparse_set_storage::create_many(const std::vector<entity_id>& ids)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mEntities.reserve(mEntities.size() + ids.size());
+    for (entity_id id : ids) {
+        mEntities.insert(id);
+    }
+}
+
+void sparse_set_storage::insert_many(batch& components)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!components.empty()) {
+        // batches usually consist of components of a single type
+        component_pool& p = poolForInsertion(components.front().second->tag());
+        p.reserve(p.size() + components.size());
+    }
+
+    auto notInserted = std::remove_if(components.begin(), components.end(),
+        [this](const auto& entry) { return !attach(entry.first, entry.second); });
+    components.erase(notInserted, components.end());
+}
+
+void sparse_set_storage::collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+    std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    // the smallest of requested pools drives the iteration,
+    // the rest of them are only probed
+    std::vector<const component_pool*> required;
+    const component_pool* smallest = nullptr;
+    for (size_t tag : bf.set_bits()) {
+        const component_pool* p = pool(tag);
+        if (!p) {
+            return;
+        }
+        required.push_back(p);
+        if (!smallest || p->size() < smallest->size()) {
+            smallest = p;
+        }
+    }
+
+    std::vector<const component_pool*> rejected;
+    for (size_t tag : excluded.set_bits()) {
+        if (const component_pool* p = pool(tag)) {
+            rejected.push_back(p);
+        }
+    }
+
+    const auto& candidates = smallest ? smallest->entities() : mEntities.ids();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        entity_id id = candidates[i];
+        auto contains = [id](const component_pool* p) { return p->contains(id); };
+        bool matches = std::all_of(required.begin(), required.end(), contains)
+            && std::none_of(rejected.begin(), rejected.end(), contains);
+        if (!matches) {
+            continue;
+        }
+
+        entities.push_back(id);
+        for (component_tag tag : tags) {
+            const component_pool* p = pool(tag);
+            if (smallest && p == smallest) {
+                components.push_back(p->components()[i]);
+            } else {
+                components.push_back(p ? p->get(id) : nullptr);
+            }
+        }
+    }
+}
+
+struct sparse_set_storage::row_cursor : public storage::cursor
+{
+    row_cursor(const sparse_set_storage& owner, const std::vector<component_tag>& tags)
+        : mOwner(owner), mTags(tags) {}
+
+    bool next(entity_id& id, std::vector<component_const_ptr>& components) override {
+        std::unique_lock<std::mutex> lock(mOwner.mMutex);
+        if (mEmpty) {
+            return false;
+        }
+
+        const component_pool* driving = mDriving ? mOwner.pool(*mDriving) : nullptr;
+        const auto& candidates = driving ? driving->entities() : mOwner.mEntities.ids();
+        while (mPosition < candidates.size()) {
+            id = candidates[mPosition++];
+            bool matches = std::all_of(mRequired.begin(), mRequired.end(),
+                [this, id](component_tag tag) { return mOwner.pool(tag)->contains(id); })
+                && std::none_of(mExcluded.begin(), mExcluded.end(), [this, id](component_tag tag) {
+                    const component_pool* p = mOwner.pool(tag);
+                    return p && p->contains(id);
+                });
+            if (!matches) {
+                continue;
+            }
+
+            for (size_t i = 0; i < mTags.size(); ++i) {
+                const component_pool* p = mOwner.pool(mTags[i]);
+                components[i] = p ? p->get(id) : nullptr;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    const sparse_set_storage& mOwner;
+    const std::vector<component_tag>& mTags;
+    std::vector<component_tag> mRequired;
+    std::vector<component_tag> mExcluded;
+    std::optional<component_tag> mDriving; // the smallest pool when opened
+    size_t mPosition = 0;
+    bool mEmpty = false;
+};
+
+std::unique_ptr<storage::cursor> sparse_set_storage::open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const
+{
+    auto result = std::make_unique<row_cursor>(*this, tags);
+    std::unique_lock<std::mutex> lock(mMutex);
+    const component_pool* smallest = nullptr;
+    for (size_t tag : bf.set_bits()) {
+        const component_pool* p = pool(tag);
+        if (!p) {
+            result->mEmpty = true;
+            break;
+        }
+        result->mRequired.push_back(tag);
+        if (!smallest || p->size() < smallest->size()) {
+            smallest = p;
+            result->mDriving = tag;
+        }
+    }
+    for (size_t tag : excluded.set_bits()) {
+        result->mExcluded.push_back(tag);
+    }
+    return result;
+}
+
+component_pool* sparse_set_storage::pool(component_tag tag) const
+{
+    if (mPools.size() <= tag) {
+        return nullptr;
+    }
+    return mPools[tag].get();
+}
+
+component_pool& sparse_set_storage::poolForInsertion(component_tag tag)
+{
+    if (mPools.size() <= tag) {
+        mPools.resize(tag + 1);
+    }
+    if (!mPools[tag]) {
+        mPools[tag] = std::make_unique<component_pool>();
+    }
+    return *mPools[tag];
+}
+
+bool sparse_set_storage::attach(entity_id id, component_ptr c)
+{
+    if (!mEntities.contains(id)) {
+        return false;
+    }
+
+    component_tag tag = c->tag();
+    return poolForInsertion(tag).insert(id, std::move(c));
+}
+} // namespace ecs
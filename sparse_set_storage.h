@@ -0,0 +1,108 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "storage.h"
+
+namespace ecs
+{
+// Set of entity ids with constant time insertion, removal and lookup.
+// Ids are kept densely packed so iterating over them touches contiguous memory,
+// sparse part is indexed by index_of(id).
+struct sparse_set
+{
+    bool contains(entity_id id) const;
+    size_t index(entity_id id) const; // id has to be contained
+    size_t size() const { return mDense.size(); }
+    const std::vector<entity_id>& ids() const { return mDense; }
+
+    bool insert(entity_id id);
+    void reserve(size_t capacity) { mDense.reserve(capacity); }
+    // moves the last id into place of the removed one,
+    // returns position of the removed id
+    size_t erase(entity_id id);
+
+private:
+    static constexpr size_t PAGE_SIZE = 4096;
+
+    size_t* slot(entity_id id) const;
+
+private:
+    // pages of positions in mDense (shifted by one, zero means "absent")
+    std::vector<std::unique_ptr<size_t[]>> mSparse;
+    std::vector<entity_id> mDense;
+};
+
+// components of a single type stored next to each other, in order of sparse_set::ids()
+struct component_pool
+{
+    bool contains(entity_id id) const { return mEntities.contains(id); }
+    component_ptr get(entity_id id) const;
+    bool insert(entity_id id, component_ptr c);
+    void replace(entity_id id, component_ptr c);
+    bool erase(entity_id id);
+    void reserve(size_t capacity);
+
+    size_t size() const { return mEntities.size(); }
+    const std::vector<entity_id>& entities() const { return mEntities.ids(); }
+    const std::vector<component_ptr>& components() const { return mComponents; }
+
+private:
+    sparse_set mEntities;
+    std::vector<component_ptr> mComponents;
+};
+
+struct sparse_set_storage : public storage
+{
+    void create(entity_id id) override;
+    bool destroy(entity_id id, bitflag& components) override;
+    bool insert(entity_id id, component_ptr c) override;
+    bool update(entity_id id, component_ptr c) override;
+    bool remove(entity_id id, component_tag tag) override;
+    component_ptr get(entity_id id, component_tag tag) const override;
+    void create_many(const std::vector<entity_id>& ids) override;
+    void insert_many(batch& components) override;
+    void collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+        std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const override;
+    std::unique_ptr<cursor> open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const override;
+
+private:
+    struct row_cursor;
+
+    component_pool* pool(component_tag tag) const;
+    // has to be called with mMutex locked
+    component_pool& poolForInsertion(component_tag tag);
+    bool attach(entity_id id, component_ptr c);
+
+private:
+    sparse_set mEntities;
+    std::vector<std::unique_ptr<component_pool>> mPools; // indexed by component tag
+    mutable std::mutex mMutex;
+};
+} // namespace ecs
@@ -0,0 +1,83 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "storage.h"
+
+#include <algorithm>
+
+namespace ecs
+{
+void storage::create_many(const std::vector<entity_id>& ids)
+{
+    for (entity_id id : ids) {
+        create(id);
+    }
+}
+
+void storage::insert_many(batch& components)
+{
+    auto notInserted = std::remove_if(components.begin(), components.end(),
+        [this](const auto& entry) { return !insert(entry.first, entry.second); });
+    components.erase(notInserted, components.end());
+}
+
+void storage::collect_from(const std::vector<entity_id>& candidates, const bitflag& bf, const bitflag& excluded,
+    const std::vector<component_tag>& tags, std::vector<entity_id>& entities,
+    std::vector<component_const_ptr>& components) const
+{
+    for (entity_id id : candidates) {
+        bool matches = true;
+        for (size_t tag : bf.set_bits()) {
+            if (!get(id, tag)) {
+                matches = false;
+                break;
+            }
+        }
+        for (size_t tag : excluded.set_bits()) {
+            if (!matches) {
+                break;
+            }
+            matches = get(id, tag) == nullptr;
+        }
+        if (!matches) {
+            continue;
+        }
+
+        entities.push_back(id);
+        for (component_tag tag : tags) {
+            components.push_back(get(id, tag));
+        }
+    }
+}
+
+bool storage::accept_revision(const component& current, component& updated)
+{
+    if (updated.mRevision != current.mRevision) {
+        return false;
+    }
+
+    ++updated.mRevision;
+    return true;
+}
+} // namespace ecs
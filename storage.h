@@ -0,0 +1,104 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "bitflag.h"
+#include "component.h"
+#include "entity_id.h"
+
+namespace ecs
+{
+
+enum class storage_t
+{
+    entity_map, // versioned map of entities, readers work on snapshots
+    sparse_set, // one dense pool per component type, O(1) lookup by entity id
+    archetype   // entities grouped by their set of components in chunked columns
+};
+
+// Storage engine behind the registry. Implementations guarantee thread-safe
+// access on their own, registry only forwards calls to them. Entities are
+// indexed by index_of(id), requests with a stale generation are rejected.
+struct storage
+{
+    using batch = std::vector<std::pair<entity_id, component_ptr>>;
+
+    // lazily walks entities matching a query, @see open
+    struct cursor
+    {
+        virtual ~cursor() = default;
+
+        // moves to the next matching entity and writes its components to
+        // 'components' (sized as 'tags'), returns false at the end
+        virtual bool next(entity_id& id, std::vector<component_const_ptr>& components) = 0;
+    };
+
+    virtual ~storage() = default;
+
+    virtual void create(entity_id id) = 0;
+
+    // removes entity with all of its components, tags of removed components
+    // are reported via 'components'
+    virtual bool destroy(entity_id id, bitflag& components) = 0;
+
+    virtual bool insert(entity_id id, component_ptr c) = 0;
+    virtual bool update(entity_id id, component_ptr c) = 0;
+    virtual bool remove(entity_id id, component_tag tag) = 0;
+    virtual component_ptr get(entity_id id, component_tag tag) const = 0;
+
+    // bulk versions of create and insert, implementations synchronize once
+    // per call instead of once per entity. Components which could not be
+    // inserted are removed from the batch.
+    virtual void create_many(const std::vector<entity_id>& ids);
+    virtual void insert_many(batch& components);
+
+    // gathers components of every entity which has all the flags set in 'bf'
+    // and none of the flags set in 'excluded'. Components of an entity are
+    // appended in order given by 'tags', absent ones as nullptr.
+    virtual void collect(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags,
+        std::vector<entity_id>& entities, std::vector<component_const_ptr>& components) const = 0;
+
+    // streaming version of collect, the bitflags, 'tags' and the storage have to
+    // outlive the cursor. Engines which do not iterate over snapshots lock
+    // only for a single step, so entities modified concurrently may be
+    // skipped or seen in their newer state.
+    virtual std::unique_ptr<cursor> open(const bitflag& bf, const bitflag& excluded, const std::vector<component_tag>& tags) const = 0;
+
+    // collect limited to 'candidates', matching entities are appended in the
+    // order of candidates. Components are read one by one, so an entity
+    // modified concurrently may be seen partially updated.
+    virtual void collect_from(const std::vector<entity_id>& candidates, const bitflag& bf, const bitflag& excluded,
+        const std::vector<component_tag>& tags, std::vector<entity_id>& entities,
+        std::vector<component_const_ptr>& components) const;
+
+protected:
+    // optimistic concurrency check of an update request, @see entity::update
+    static bool accept_revision(const component& current, component& updated);
+};
+} // namespace ecs
@@ -40,3 +40,8 @@ struct IntComponent : ecs::component
 
     int number = 0;
 };
+
+struct MarkerComponent : ecs::component
+{
+    ECS_COMPONENT(MarkerComponent)
+};
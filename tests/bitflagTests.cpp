@@ -26,6 +26,9 @@
 
 #include "bitflag.h"
 
+#include <unordered_map>
+#include <vector>
+
 TEST(BitflagShould, SetAndUnsetProperFlag)
 {
     bitflag f(4);
@@ -63,6 +66,38 @@ TEST(BitflagShould, Reverse)
     EXPECT_EQ("111011", second.str());
 }
 
+TEST(BitflagShould, BeEqualRegardlessOfTrailingDisabledFlags)
+{
+    bitflag first(3);
+    first.set(1, true);
+    bitflag second(12);
+    second.set(1, true);
+    EXPECT_TRUE(first == second);
+
+    second.set(10, true);
+    EXPECT_TRUE(first != second);
+    first.resize(11);
+    first.set(10, true);
+    EXPECT_TRUE(first == second);
+}
+
+TEST(BitflagShould, IntersectOnlyWhenAnyFlagIsEnabledInBoth)
+{
+    bitflag first(20);
+    first.set(2, true);
+    first.set(17, true);
+    bitflag second(18);
+    second.set(3, true);
+    EXPECT_FALSE(first.intersects(second));
+
+    second.set(17, true);
+    EXPECT_TRUE(first.intersects(second));
+    EXPECT_TRUE(second.intersects(first));
+
+    second.resize(17);
+    EXPECT_FALSE(first.intersects(second));
+}
+
 TEST(BitflagShould, CompareWithBitAndOperationLessThanByte)
 {
     bitflag first(6);
@@ -103,8 +138,87 @@ TEST(BitflagShould, CompareWithBitAndOperationTwoBytes)
     ASSERT_TRUE(first.has(second));
 
     first.set(1, true);
-    ASSERT_FALSE(first.has(second));
+    ASSERT_TRUE(first.has(second));
 
     second.set(1, true);
     ASSERT_TRUE(first.has(second));
+
+    second.resize(14);
+    second.set(13, true);
+    ASSERT_FALSE(first.has(second));
+}
+
+TEST(BitflagShould, KeepFlagsWhenGrowingBeyondInlineStorage)
+{
+    bitflag first(100);
+    first.set(5, true);
+    first.set(99, true);
+    first.resize(bitflag::INLINE_BITS * 3);
+    first.set(300, true);
+    EXPECT_EQ(3, first.enabled_flags_count());
+
+    bitflag copy(first);
+    bitflag moved(std::move(copy));
+    EXPECT_TRUE(moved == first);
+    EXPECT_TRUE(moved.has(first));
+    EXPECT_EQ(bitflag::INLINE_BITS * 3 - 3, (!moved).enabled_flags_count());
+
+    bitflag small(7);
+    small.set(5, true);
+    EXPECT_TRUE(first.has(small));
+    EXPECT_FALSE(small.has(first));
+
+    first.resize(50);
+    EXPECT_EQ(1, first.enabled_flags_count());
+    first.resize(400);
+    EXPECT_FALSE(first.at(99));
+    EXPECT_FALSE(first.at(300));
+}
+
+TEST(BitflagShould, IterateOverEnabledFlagsOnly)
+{
+    bitflag bf(200);
+    for (size_t pos : { 0, 63, 64, 130, 199 }) {
+        bf.set(pos, true);
+    }
+
+    std::vector<size_t> found(bf.set_bits().begin(), bf.set_bits().end());
+    EXPECT_EQ(std::vector<size_t>({ 0, 63, 64, 130, 199 }), found);
+    EXPECT_EQ(130, bf.find_next(65));
+    EXPECT_EQ(200, bitflag(200).find_next(0));
+}
+
+TEST(BitflagShould, CombineFlagsInPlace)
+{
+    bitflag first(4);
+    first.set(0, true);
+    first.set(1, true);
+    bitflag second(70);
+    second.set(1, true);
+    second.set(69, true);
+
+    EXPECT_EQ("0100", (first & second).str());
+    EXPECT_EQ(70, (first | second).size());
+    EXPECT_EQ(3, (first | second).enabled_flags_count());
+    EXPECT_EQ(2, (first ^ second).enabled_flags_count());
+    EXPECT_TRUE((first ^ second).at(0));
+
+    first.and_not(second);
+    EXPECT_EQ("1000", first.str());
+}
+
+TEST(BitflagShould, HashEqualFlagsEqually)
+{
+    bitflag first(3);
+    first.set(2, true);
+    bitflag second(300);
+    second.set(2, true);
+    ASSERT_TRUE(first == second);
+    EXPECT_EQ(std::hash<bitflag>()(first), std::hash<bitflag>()(second));
+
+    std::unordered_map<bitflag, int> signatures;
+    signatures[first] = 1;
+    EXPECT_EQ(1, signatures[second]);
+    second.set(299, true);
+    EXPECT_EQ(0, signatures.count(second));
 }
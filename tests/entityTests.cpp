@@ -26,6 +26,9 @@
 
 #include <entity.h>
 
+#include <atomic>
+#include <thread>
+
 #include "TestComponents.h"
 
 TEST(EntityShould, HaveComponentAfterInsert)
@@ -111,3 +114,117 @@ TEST(EntityShould, InsertAndRemoveComponent)
     ASSERT_TRUE(e.remove(ecs::component::tag_t<IntComponent>()));
     ASSERT_FALSE(e.has(ecs::component::tag_t<IntComponent>()));
 }
+
+TEST(EntityShould, ModifyUnpublishedCopyWithoutChangingOriginal)
+{
+    ecs::entity original(0);
+    original.insert(std::make_shared<IntComponent>());
+    const ecs::component_tag tag = ecs::component::tag_t<IntComponent>();
+
+    ecs::entity copy(original);
+    auto stale = std::make_shared<IntComponent>();
+    auto updated = std::make_shared<IntComponent>();
+    updated->number = 10;
+    ASSERT_TRUE(copy.update_unsafely(updated));
+    // update_unsafely bumped the revision stored in the copy
+    ASSERT_FALSE(copy.update_unsafely(stale));
+    ASSERT_FALSE(copy.insert_unsafely(std::make_shared<IntComponent>()));
+    ASSERT_TRUE(copy.insert_unsafely(std::make_shared<StringComponent>()));
+
+    EXPECT_EQ(10, std::static_pointer_cast<const IntComponent>(copy.get(tag))->number);
+    EXPECT_EQ(0, std::static_pointer_cast<const IntComponent>(original.get(tag))->number);
+    EXPECT_FALSE(original.has(ecs::component::tag_t<StringComponent>()));
+
+    ASSERT_TRUE(copy.remove_unsafely(tag));
+    EXPECT_FALSE(copy.has(tag));
+    EXPECT_TRUE(original.has(tag));
+}
+
+TEST(EntityShould, ReadSameComponentsWithoutGuard)
+{
+    ecs::entity e(0);
+    auto intComp = std::make_shared<IntComponent>();
+    e.insert(intComp);
+    const ecs::component_tag tag = ecs::component::tag_t<IntComponent>();
+    bitflag stringFlag(ecs::component::tag_t<StringComponent>() + 1);
+    stringFlag.set(ecs::component::tag_t<StringComponent>(), true);
+
+    EXPECT_EQ(e.get_bitflag(), e.get_bitflag_unsafely());
+    EXPECT_TRUE(e.has_unsafely(e.get_bitflag()));
+    EXPECT_FALSE(e.intersects_unsafely(stringFlag));
+    EXPECT_EQ(intComp, e.get_unsafely(tag));
+    EXPECT_EQ(nullptr, e.get_unsafely(ecs::component::tag_t<StringComponent>()));
+}
+
+TEST(EntityShould, NotLoseUpdatesOfConcurrentWritersNorBlockReaders)
+{
+    const ecs::component_tag tag = ecs::component::tag_t<IntComponent>();
+    ecs::entity e(0);
+    e.insert(std::make_shared<IntComponent>());
+
+    std::atomic<bool> done { false };
+    std::thread reader([&]() {
+        int last = 0;
+        while (!done) {
+            auto comp = std::static_pointer_cast<const IntComponent>(e.get(tag));
+            ASSERT_TRUE(comp);
+            ASSERT_LE(last, comp->number);
+            last = comp->number;
+        }
+    });
+
+    std::atomic<int> updates { 0 };
+    std::vector<std::thread> writers;
+    for (size_t i = 0; i < 4; ++i) {
+        writers.emplace_back([&]() {
+            while (updates < 1000) {
+                auto clone = std::static_pointer_cast<const IntComponent>(e.get(tag))->clone();
+                ++clone.number;
+                if (e.update(std::make_shared<IntComponent>(std::move(clone)))) {
+                    ++updates;
+                }
+            }
+        });
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(updates, std::static_pointer_cast<const IntComponent>(e.get(tag))->number);
+}
+
+namespace
+{
+struct NeverConstructedComponent : ecs::component
+{
+    ECS_COMPONENT(NeverConstructedComponent)
+};
+
+struct OtherNeverConstructedComponent : ecs::component
+{
+    ECS_COMPONENT(OtherNeverConstructedComponent)
+};
+}
+
+TEST(ComponentShould, HaveTagAssignedOnceWithoutConstructingInstance)
+{
+    std::vector<ecs::component_tag> tags(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < tags.size(); ++i) {
+        threads.emplace_back([&tags, i]() {
+            tags[i] = ecs::component::tag_t<NeverConstructedComponent>();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (ecs::component_tag tag : tags) {
+        EXPECT_EQ(tags.front(), tag);
+    }
+    EXPECT_EQ(tags.front(), ecs::component::tag_t<const NeverConstructedComponent>());
+    EXPECT_NE(tags.front(), ecs::component::tag_t<OtherNeverConstructedComponent>());
+    EXPECT_EQ(ecs::component::tag_t<IntComponent>(), IntComponent().tag());
+}
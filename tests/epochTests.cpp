@@ -0,0 +1,119 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <epoch.h>
+#include <registry.h>
+
+#include "TestComponents.h"
+
+namespace
+{
+struct tracked
+{
+    explicit tracked(std::atomic<int>& counter) : counter(counter) {}
+    ~tracked() { ++counter; }
+    std::atomic<int>& counter;
+};
+}
+
+TEST(EpochShould, DeleteRetiredObjectOnlyAfterReadersLeave)
+{
+    std::atomic<int> deleted { 0 };
+    ecs::epoch::reclaim();
+
+    std::atomic<bool> guardTaken { false };
+    std::atomic<bool> release { false };
+    std::thread reader([&]() {
+        ecs::epoch::guard guard;
+        guardTaken = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (!guardTaken) {
+        std::this_thread::yield();
+    }
+
+    ecs::epoch::retire(new tracked(deleted));
+    ecs::epoch::reclaim();
+    EXPECT_EQ(0, deleted);
+
+    release = true;
+    reader.join();
+    ecs::epoch::reclaim();
+    EXPECT_EQ(1, deleted);
+}
+
+TEST(EpochShould, AllowNestedGuards)
+{
+    std::atomic<int> deleted { 0 };
+    {
+        ecs::epoch::guard outer;
+        {
+            ecs::epoch::guard inner;
+        }
+        ecs::epoch::retire(new tracked(deleted));
+        ecs::epoch::reclaim();
+        EXPECT_EQ(0, deleted);
+    }
+    ecs::epoch::reclaim();
+    EXPECT_EQ(1, deleted);
+}
+
+TEST(EpochShould, LetReadersSelectComponentsWhileTheyAreUpdated)
+{
+    ecs::registry reg;
+    ecs::entity_id e = reg.createEntity();
+    reg.insert(e, IntComponent());
+
+    std::atomic<bool> done { false };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            int last = 0;
+            while (!done) {
+                auto c = reg.select<IntComponent>(e);
+                ASSERT_NE(nullptr, c);
+                ASSERT_LE(last, c->number);
+                last = c->number;
+            }
+        });
+    }
+
+    for (int i = 0; i < 5000; ++i) {
+        auto updated = reg.select<IntComponent>(e)->clone();
+        ++updated.number;
+        ASSERT_TRUE(reg.update(e, std::move(updated)));
+    }
+    done = true;
+    for (auto& r : readers) {
+        r.join();
+    }
+    EXPECT_EQ(5000, reg.select<IntComponent>(e)->number);
+}
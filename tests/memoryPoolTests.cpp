@@ -0,0 +1,148 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <epoch.h>
+#include <memory_pool.h>
+#include <registry.h>
+
+#include "TestComponents.h"
+
+#include <thread>
+#include <vector>
+
+using namespace ecs;
+
+namespace
+{
+size_t inUse(const memory_pool::stats& s)
+{
+    size_t result = s.oversized_in_use;
+    for (const auto& sc : s.classes) {
+        result += sc.in_use;
+    }
+    return result;
+}
+}
+
+TEST(MemoryPoolShould, ReuseReleasedBlocksOfTheSameSizeClass)
+{
+    memory_pool pool;
+    void* first = pool.allocate(24, alignof(std::max_align_t));
+    pool.deallocate(first, 24, alignof(std::max_align_t));
+    void* second = pool.allocate(30, 8);
+
+    EXPECT_EQ(first, second);
+
+    auto s = pool.statistics();
+    ASSERT_EQ(memory_pool::SIZE_CLASSES, s.classes.size());
+    EXPECT_EQ(32, s.classes[1].block_size);
+    EXPECT_EQ(memory_pool::BLOCKS_PER_SLAB, s.classes[1].capacity);
+    EXPECT_EQ(1, s.classes[1].in_use);
+
+    pool.deallocate(second, 30, 8);
+    EXPECT_EQ(0, inUse(pool.statistics()));
+}
+
+TEST(MemoryPoolShould, ServeOversizedRequestsFromGlobalAllocator)
+{
+    memory_pool pool;
+    void* p = pool.allocate(memory_pool::MAX_BLOCK_SIZE + 1, 8);
+    EXPECT_EQ(1, pool.statistics().oversized_in_use);
+
+    pool.deallocate(p, memory_pool::MAX_BLOCK_SIZE + 1, 8);
+    EXPECT_EQ(0, pool.statistics().oversized_in_use);
+}
+
+TEST(MemoryPoolShould, ReturnBlocksFreedByOtherThreadsOnceTheyExit)
+{
+    memory_pool pool;
+    const size_t blocksPerThread = 10 * memory_pool::CACHE_BATCH;
+    std::vector<std::vector<void*>> allocated(4);
+    std::vector<std::thread> threads;
+    for (auto& blocks : allocated) {
+        threads.emplace_back([&pool, &blocks, blocksPerThread]() {
+            for (size_t i = 0; i < blocksPerThread; ++i) {
+                blocks.push_back(pool.allocate(16, 8));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(allocated.size() * blocksPerThread, inUse(pool.statistics()));
+
+    // every thread frees blocks allocated by another one
+    threads.clear();
+    for (size_t t = 0; t < allocated.size(); ++t) {
+        threads.emplace_back([&pool, &allocated, t]() {
+            for (void* p : allocated[(t + 1) % allocated.size()]) {
+                pool.deallocate(p, 16, 8);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto s = pool.statistics();
+    EXPECT_EQ(0, inUse(s));
+    EXPECT_EQ(allocated.size() * blocksPerThread, s.classes[0].capacity);
+}
+
+TEST(MemoryPoolShould, LetThreadOutliveEveryPoolItUsed)
+{
+    std::thread user([]() {
+        for (int i = 0; i < 3; ++i) {
+            memory_pool pool;
+            void* p = pool.allocate(16, 8);
+            pool.deallocate(p, 16, 8);
+            EXPECT_EQ(0, inUse(pool.statistics()));
+        }
+    });
+    user.join();
+}
+
+TEST(MemoryPoolShould, AllocateRegistryComponentsAndOutliveRegistry)
+{
+    std::shared_ptr<const IntComponent> kept;
+    {
+        registry reg;
+        entity_id e = reg.createEntity();
+        reg.insert(e, IntComponent());
+        EXPECT_EQ(1, inUse(reg.memory_statistics()));
+
+        for (int i = 0; i < 10; ++i) {
+            reg.modify<IntComponent>(e, [](IntComponent& c) { ++c.number; });
+        }
+        // replaced versions go back to the pool once snapshot readers are gone
+        epoch::reclaim();
+        EXPECT_EQ(1, inUse(reg.memory_statistics()));
+
+        kept = reg.select<IntComponent>(e);
+    }
+
+    EXPECT_EQ(10, kept->number);
+}
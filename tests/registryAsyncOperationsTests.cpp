@@ -31,6 +31,10 @@
 
 #include <reactive_system.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 using namespace ecs;
 
 struct AsyncInsertIntComponent : public command
@@ -209,3 +213,423 @@ TEST(RegistryShould, HandleTwoAsyncSystemsUpdatingTheSameComponentAtOnce)
     updater2.join();
     EXPECT_EQ(10000, reg.select<IntComponent>(ee)->number);
 }
+
+namespace
+{
+// lets a test hold a subscriber inside its callback
+struct gate
+{
+    void wait_entered() {
+        while (!entered) {
+            std::this_thread::yield();
+        }
+    }
+    void pass() {
+        entered = true;
+        while (!opened) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<bool> entered { false };
+    std::atomic<bool> opened { false };
+};
+}
+
+TEST(RegistryShould, NotBlockWriterOnSlowAsynchronousSubscriber)
+{
+    registry reg;
+    entity_id eid = reg.createEntity();
+
+    gate g;
+    std::vector<int> received;
+    reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>& nn) {
+        g.pass();
+        received.push_back(nn.component->number);
+    });
+
+    IntComponent intComponent;
+    intComponent.number = 1;
+    ASSERT_TRUE(reg.insert(eid, std::move(intComponent)));
+    g.wait_entered();
+    EXPECT_TRUE(received.empty());
+
+    g.opened = true;
+    reg.flush_notifications();
+    EXPECT_EQ(std::vector<int>({ 1 }), received);
+}
+
+TEST(RegistryShould, DropOldestNotificationsWhenAsynchronousQueueIsFull)
+{
+    registry reg;
+    std::vector<entity_id> entities = reg.createEntities(4);
+
+    gate g;
+    std::vector<entity_id> received;
+    delivery_options options;
+    options.capacity = 2;
+    options.backpressure = backpressure_t::drop_oldest;
+    reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>& nn) {
+        g.pass();
+        received.push_back(nn.entityId);
+    }, options);
+
+    reg.insert(entities[0], IntComponent());
+    g.wait_entered();
+    for (size_t i = 1; i < entities.size(); ++i) {
+        reg.insert(entities[i], IntComponent());
+    }
+
+    g.opened = true;
+    reg.flush_notifications();
+    EXPECT_EQ(std::vector<entity_id>({ entities[0], entities[2], entities[3] }), received);
+}
+
+TEST(RegistryShould, CoalescePendingNotificationsOfTheSameEntity)
+{
+    registry reg;
+    entity_id first = reg.createEntity();
+    entity_id second = reg.createEntity();
+    reg.insert(second, IntComponent());
+
+    gate g;
+    std::vector<int> received;
+    delivery_options options;
+    options.backpressure = backpressure_t::coalesce;
+    reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>& nn) {
+        g.pass();
+        received.push_back(nn.component->number);
+    }, options);
+
+    reg.insert(first, IntComponent());
+    g.wait_entered();
+    for (int i = 1; i <= 100; ++i) {
+        ASSERT_TRUE(reg.modify<IntComponent>(second, [i](IntComponent& c) { c.number = i; }));
+    }
+
+    g.opened = true;
+    reg.flush_notifications();
+    EXPECT_EQ(std::vector<int>({ 0, 100 }), received);
+}
+
+TEST(RegistryShould, KeepInsertionWhenCoalescingItWithUpdate)
+{
+    registry reg;
+    entity_id first = reg.createEntity();
+    entity_id second = reg.createEntity();
+
+    gate g;
+    std::vector<Notification<IntComponent>> received;
+    delivery_options options;
+    options.backpressure = backpressure_t::coalesce;
+    reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>& nn) {
+        g.pass();
+        received.push_back(nn);
+    }, options);
+
+    reg.insert(first, IntComponent());
+    g.wait_entered();
+    reg.insert(second, IntComponent());
+    ASSERT_TRUE(reg.modify<IntComponent>(second, [](IntComponent& c) { c.number = 5; }));
+
+    g.opened = true;
+    reg.flush_notifications();
+    ASSERT_EQ(2, received.size());
+    EXPECT_EQ(operation_t::inserted, received[1].operation);
+    EXPECT_EQ(second, received[1].entityId);
+    EXPECT_EQ(5, received[1].component->number);
+}
+
+TEST(RegistryShould, StopAsynchronousDeliveryAfterUnsubscribing)
+{
+    registry reg;
+    entity_id eid = reg.createEntity();
+
+    std::atomic<size_t> notifications { 0 };
+    auto unsubscribe = reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>&) {
+        ++notifications;
+    });
+
+    reg.insert(eid, IntComponent());
+    reg.flush_notifications();
+    unsubscribe();
+    reg.update(eid, IntComponent());
+    reg.flush_notifications();
+
+    EXPECT_EQ(1, notifications);
+}
+
+TEST(RegistryShould, DeliverAsynchronouslyComponentsInsertedInBatch)
+{
+    registry reg;
+    std::vector<entity_id> entities = reg.createEntities(3);
+
+    std::atomic<size_t> notifications { 0 };
+    reg.subscribe_async<IntComponent>([&](const Notification<IntComponent>& nn) {
+        EXPECT_EQ(operation_t::inserted, nn.operation);
+        ++notifications;
+    });
+
+    std::vector<std::pair<entity_id, IntComponent>> components(entities.size());
+    for (size_t i = 0; i < entities.size(); ++i) {
+        components[i].first = entities[i];
+    }
+    EXPECT_EQ(3, reg.insert_many<IntComponent>(components));
+    reg.flush_notifications();
+
+    EXPECT_EQ(3, notifications);
+}
+
+TEST(RegistryShould, DeliverCoalescedBatchOnFlush)
+{
+    registry reg;
+    entity_id first = reg.createEntity();
+    entity_id second = reg.createEntity();
+
+    std::vector<std::vector<Notification<IntComponent>>> batches;
+    reg.subscribe_batched<IntComponent>([&](const std::vector<Notification<IntComponent>>& batch) {
+        batches.push_back(batch);
+    });
+
+    reg.insert(first, IntComponent());
+    reg.insert(second, IntComponent());
+    for (int i = 1; i <= 1000; ++i) {
+        reg.modify<IntComponent>(second, [i](IntComponent& c) { c.number = i; });
+    }
+    EXPECT_TRUE(batches.empty());
+
+    reg.flush_notifications();
+    ASSERT_EQ(1, batches.size());
+    ASSERT_EQ(2, batches[0].size());
+    EXPECT_EQ(first, batches[0][0].entityId);
+    EXPECT_EQ(second, batches[0][1].entityId);
+    EXPECT_EQ(operation_t::inserted, batches[0][1].operation);
+    EXPECT_EQ(1000, batches[0][1].component->number);
+
+    reg.remove<IntComponent>(first);
+    reg.flush_notifications();
+    reg.flush_notifications();
+    ASSERT_EQ(2, batches.size());
+    ASSERT_EQ(1, batches[1].size());
+    EXPECT_EQ(operation_t::removed, batches[1][0].operation);
+}
+
+TEST(RegistryShould, DeliverComponentsInsertedInBatchInOneBatchedNotification)
+{
+    registry reg;
+    std::vector<entity_id> entities = reg.createEntities(3);
+
+    std::vector<std::vector<Notification<IntComponent>>> batches;
+    reg.subscribe_batched<IntComponent>([&](const std::vector<Notification<IntComponent>>& batch) {
+        batches.push_back(batch);
+    });
+
+    std::vector<std::pair<entity_id, IntComponent>> components(entities.size());
+    for (size_t i = 0; i < entities.size(); ++i) {
+        components[i].first = entities[i];
+    }
+    EXPECT_EQ(3, reg.insert_many<IntComponent>(components));
+    reg.flush_notifications();
+
+    ASSERT_EQ(1, batches.size());
+    ASSERT_EQ(3, batches[0].size());
+    for (size_t i = 0; i < entities.size(); ++i) {
+        EXPECT_EQ(entities[i], batches[0][i].entityId);
+        EXPECT_EQ(operation_t::inserted, batches[0][i].operation);
+    }
+}
+
+TEST(RegistryShould, DeliverBatchOnInterval)
+{
+    registry reg;
+    entity_id eid = reg.createEntity();
+
+    std::atomic<size_t> batches { 0 };
+    std::atomic<size_t> notifications { 0 };
+    batch_options options;
+    options.interval = std::chrono::milliseconds(5);
+    reg.subscribe_batched<IntComponent>([&](const std::vector<Notification<IntComponent>>& batch) {
+        notifications += batch.size();
+        ++batches;
+    }, options);
+
+    reg.insert(eid, IntComponent());
+    for (int i = 0; i < 200 && batches == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    EXPECT_EQ(1, batches);
+    EXPECT_EQ(1, notifications);
+}
+
+namespace
+{
+struct CountingCommand : public command
+{
+    CountingCommand(std::atomic<size_t>& counter, std::function<void()> then = nullptr)
+        : counter(counter), then(std::move(then)) {}
+    void execute() override {
+        ++counter;
+        if (then) {
+            then();
+        }
+    }
+    std::atomic<size_t>& counter;
+    std::function<void()> then;
+};
+
+struct ParallelSystem : public reactive_system
+{
+    explicit ParallelSystem(size_t parallelism) : reactive_system(parallelism) {}
+    using reactive_system::add_task;
+};
+}
+
+TEST(ReactiveSystemShould, RunTasksOnManyWorkersIncludingTasksAddedByTasks)
+{
+    ParallelSystem system(4);
+    EXPECT_EQ(4, system.parallelism());
+
+    std::atomic<size_t> executed { 0 };
+    std::atomic<size_t> spawned { 0 };
+    system.add_task(std::make_unique<CountingCommand>(executed));
+    system.start();
+    for (size_t i = 0; i < 100; ++i) {
+        system.add_task(std::make_unique<CountingCommand>(executed, [&]() {
+            system.add_task(std::make_unique<CountingCommand>(spawned));
+        }));
+    }
+
+    for (int i = 0; i < 1000 && (executed < 101 || spawned < 100); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    system.stop();
+    system.join();
+
+    EXPECT_EQ(101, executed);
+    EXPECT_EQ(100, spawned);
+}
+
+TEST(ReactiveSystemShould, RunTasksOfManyProducersBeyondQueueCapacityInProducerOrder)
+{
+    ParallelSystem system(1);
+    const size_t producers = 8;
+    const size_t tasksPerProducer = 2000;
+
+    std::atomic<size_t> executed { 0 };
+    std::atomic<size_t> spawned { 0 };
+    // written only by the system thread
+    std::vector<size_t> lastSeen(producers, 0);
+    std::atomic<bool> inOrder { true };
+
+    system.start();
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (size_t i = 1; i <= tasksPerProducer; ++i) {
+                system.add_task(std::make_unique<CountingCommand>(executed, [&, p, i]() {
+                    if (lastSeen[p] + 1 != i) {
+                        inOrder = false;
+                    }
+                    lastSeen[p] = i;
+                    if (i % 100 == 0) {
+                        system.add_task(std::make_unique<CountingCommand>(spawned));
+                    }
+                }));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const size_t expectedSpawned = producers * tasksPerProducer / 100;
+    for (int i = 0; i < 5000 && (executed < producers * tasksPerProducer || spawned < expectedSpawned); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    system.stop();
+    system.join();
+
+    EXPECT_EQ(producers * tasksPerProducer, executed);
+    EXPECT_EQ(expectedSpawned, spawned);
+    EXPECT_TRUE(inOrder);
+}
+
+TEST(ReactiveSystemShould, RunTasksAddedByItsOwnTaskBeyondQueueCapacityInOrder)
+{
+    ParallelSystem system(1);
+    const size_t tasks = 10000;
+
+    std::atomic<size_t> executed { 0 };
+    std::atomic<size_t> spawned { 0 };
+    // written only by the system thread
+    size_t lastSeen = 0;
+    bool inOrder = true;
+    system.add_task(std::make_unique<CountingCommand>(executed, [&]() {
+        for (size_t i = 1; i <= tasks; ++i) {
+            system.add_task(std::make_unique<CountingCommand>(spawned, [&, i]() {
+                inOrder = inOrder && lastSeen + 1 == i;
+                lastSeen = i;
+            }));
+        }
+    }));
+    system.start();
+
+    for (int i = 0; i < 5000 && spawned < tasks; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    system.stop();
+    system.join();
+
+    EXPECT_EQ(1, executed);
+    EXPECT_EQ(tasks, spawned);
+    EXPECT_TRUE(inOrder);
+}
+
+TEST(ReactiveSystemShould, RejectTasksBeyondQueueCapacityBeforeStartInsteadOfWaiting)
+{
+    ParallelSystem system(1);
+
+    std::atomic<size_t> executed { 0 };
+    size_t accepted = 0;
+    while (accepted < 100000 && system.add_task(std::make_unique<CountingCommand>(executed))) {
+        ++accepted;
+    }
+    ASSERT_LT(accepted, 100000);
+
+    system.start();
+    for (int i = 0; i < 5000 && executed < accepted; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    system.stop();
+    system.join();
+
+    EXPECT_EQ(accepted, executed);
+}
+
+TEST(ReactiveSystemShould, GoThroughTheSameStatesWithAndWithoutExecutor)
+{
+    for (size_t parallelism : { 1, 4 }) {
+        ParallelSystem joined(parallelism);
+        EXPECT_EQ(reactive_system::state_t::idle, joined.state());
+        joined.start();
+        EXPECT_EQ(reactive_system::state_t::running, joined.state());
+        joined.stop();
+        joined.join();
+        EXPECT_EQ(reactive_system::state_t::idle, joined.state());
+        joined.join();
+
+        // the destructor joins a system which was only stopped
+        std::atomic<size_t> executed { 0 };
+        {
+            ParallelSystem stopped(parallelism);
+            stopped.start();
+            stopped.add_task(std::make_unique<CountingCommand>(executed, [&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            stopped.stop();
+        }
+        EXPECT_LE(executed, 1);
+    }
+}
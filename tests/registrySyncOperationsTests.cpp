@@ -117,6 +117,26 @@ TEST(RegistryShould, SubscribeForUpdateAndGetNotification)
     EXPECT_TRUE(isUpdateNotifReceived);
 }
 
+TEST(RegistryShould, ModifyComponentAndNotifyUpdate)
+{
+    registry reg;
+    entity_id e = reg.createEntity();
+    reg.insert(e, IntComponent());
+
+    int notifiedNumber = 0;
+    reg.subscribe<IntComponent>([&notifiedNumber](const Notification<IntComponent>& notif) {
+        notifiedNumber = notif.component->number;
+    });
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(reg.modify<IntComponent>(e, [](IntComponent& c) { c.number += 5; }));
+    }
+
+    EXPECT_EQ(15, reg.select<IntComponent>(e)->number);
+    EXPECT_EQ(15, notifiedNumber);
+    EXPECT_FALSE(reg.modify<StringComponent>(e, [](StringComponent& c) { c.name = "X"; }));
+}
+
 TEST(RegistryShould, SubscribeForInsertAndGetNotification)
 {
     registry reg;
@@ -241,3 +261,208 @@ TEST(RegistryShould, SubscribeAndUnsubscribe)
 
     EXPECT_FALSE(isRemovedNotifReceived);
 }
+
+TEST(RegistryShould, NotifyOnlySubscribersOfModifiedComponentType)
+{
+    registry reg;
+    entity_id e = reg.createEntity();
+
+    size_t stringNotifications = 0;
+    size_t intNotifications = 0;
+    reg.subscribe<StringComponent>([&stringNotifications](const Notification<StringComponent>&) {
+        ++stringNotifications;
+    });
+    reg.subscribe<IntComponent>([&intNotifications](const Notification<IntComponent>&) {
+        ++intNotifications;
+    });
+
+    reg.insert(e, IntComponent());
+    reg.update(e, IntComponent());
+    reg.remove(e);
+
+    EXPECT_EQ(0, stringNotifications);
+    EXPECT_EQ(3, intNotifications);
+}
+
+TEST(RegistryShould, AllowUnsubscribingFromWithinNotification)
+{
+    registry reg;
+    entity_id e = reg.createEntity();
+
+    size_t notifications = 0;
+    registry::Unsubscriber unsubscribe;
+    unsubscribe = reg.subscribe<IntComponent>([&](const Notification<IntComponent>&) {
+        ++notifications;
+        unsubscribe();
+    });
+
+    reg.insert(e, IntComponent());
+    reg.update(e, IntComponent());
+
+    EXPECT_EQ(1, notifications);
+}
+
+TEST(RegistryShould, SelectOnlyEntitiesChangedSinceRevision)
+{
+    registry reg;
+    reg.track_changes<IntComponent, StringComponent>();
+    entity_id e1 = reg.createEntity();
+    entity_id e2 = reg.createEntity();
+    entity_id e3 = reg.createEntity();
+    reg.insert(e1, IntComponent());
+    reg.insert(e2, IntComponent());
+    reg.insert(e3, StringComponent());
+
+    size_t revision = reg.revision();
+    EXPECT_EQ(2, reg.select_changed<IntComponent>(0).entities().size());
+    EXPECT_EQ(0, reg.select_changed<IntComponent>(revision).entities().size());
+
+    IntComponent updated;
+    updated.number = 5;
+    reg.update(e2, std::move(updated));
+    reg.update(e3, StringComponent());
+
+    auto changed = reg.select_changed<IntComponent>(revision);
+    ASSERT_EQ(1, changed.entities().size());
+    ASSERT_NE(nullptr, changed.select<IntComponent>(e2));
+    EXPECT_EQ(5, changed.select<IntComponent>(e2)->number);
+    EXPECT_EQ(0, reg.select_changed<IntComponent>(reg.revision()).entities().size());
+}
+
+TEST(RegistryShould, SelectEntitiesWithRemovedComponentsAsChanged)
+{
+    registry reg;
+    reg.track_changes<IntComponent, StringComponent, MarkerComponent>();
+    entity_id e1 = reg.createEntity();
+    entity_id e2 = reg.createEntity();
+    reg.insert(e1, IntComponent());
+    reg.insert(e1, MarkerComponent());
+    reg.insert(e2, IntComponent());
+    reg.insert(e2, StringComponent());
+
+    size_t revision = reg.revision();
+    reg.remove<MarkerComponent>(e1);
+    reg.remove<StringComponent>(e2);
+
+    auto withoutMarker = reg.select_changed<IntComponent, without<MarkerComponent>>(revision);
+    ASSERT_EQ(1, withoutMarker.entities().size());
+    EXPECT_NE(nullptr, withoutMarker.select<IntComponent>(e1));
+
+    auto optionalString = reg.select_changed<IntComponent, optional<StringComponent>>(revision);
+    ASSERT_EQ(1, optionalString.entities().size());
+    EXPECT_NE(nullptr, optionalString.select<IntComponent>(e2));
+    EXPECT_EQ(nullptr, optionalString.select<StringComponent>(e2));
+
+    EXPECT_EQ(0, reg.select_changed<StringComponent>(revision).entities().size());
+}
+
+TEST(RegistryShould, TrackChangesOfManyUpdatesOfFewEntities)
+{
+    registry reg;
+    reg.track_changes<IntComponent>();
+    std::vector<entity_id> entities = reg.createEntities(3);
+    for (entity_id e : entities) {
+        reg.insert(e, IntComponent());
+    }
+
+    size_t revision = 0;
+    for (int i = 1; i <= 5000; ++i) {
+        if (i == 4000) {
+            revision = reg.revision();
+        }
+        entity_id e = i < 4000 ? entities[i % 3] : entities[0];
+        reg.modify<IntComponent>(e, [i](IntComponent& c) { c.number = i; });
+    }
+
+    auto changed = reg.select_changed<IntComponent>(revision);
+    ASSERT_EQ(1, changed.entities().size());
+    EXPECT_EQ(5000, changed.select<IntComponent>(entities[0])->number);
+    EXPECT_EQ(3, reg.select_changed<IntComponent>(0).entities().size());
+}
+
+TEST(RegistryShould, SelectAllEntitiesAsChangedWhenTypeIsNotTracked)
+{
+    registry reg;
+    reg.track_changes<StringComponent>();
+    std::vector<entity_id> entities = reg.createEntities(2);
+    reg.insert(entities[0], IntComponent());
+    reg.insert(entities[1], IntComponent());
+
+    EXPECT_EQ(0, reg.revision());
+    EXPECT_EQ(2, reg.select_changed<IntComponent>(reg.revision()).entities().size());
+    auto withOptional = reg.select_changed<IntComponent, optional<StringComponent>>(reg.revision());
+    EXPECT_EQ(2, withOptional.entities().size());
+}
+
+TEST(RegistryShould, SelectAllEntitiesAsChangedSinceRevisionOlderThanHistory)
+{
+    registry reg;
+    reg.track_changes<IntComponent>(64);
+    std::vector<entity_id> entities = reg.createEntities(200);
+
+    size_t revision = 0;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        if (i == 190) {
+            revision = reg.revision();
+        }
+        reg.insert(entities[i], IntComponent());
+    }
+    // destroyed entities are forgotten, recycled ids are tracked anew
+    for (size_t i = 0; i < 100; ++i) {
+        reg.remove(entities[i]);
+    }
+
+    EXPECT_EQ(10, reg.select_changed<IntComponent>(revision).entities().size());
+    EXPECT_EQ(100, reg.select_changed<IntComponent>(0).entities().size());
+}
+
+TEST(RegistryShould, NotifyEntityScopedSubscriberOnlyAboutItsEntities)
+{
+    registry reg;
+    std::vector<entity_id> entities = reg.createEntities(4);
+
+    std::vector<entity_id> notified;
+    size_t preconditionCalls = 0;
+    subscription_filter filter;
+    filter.entities = { entities[1], entities[3] };
+    reg.subscribe<IntComponent>([&notified](const Notification<IntComponent>& notif) {
+        notified.push_back(notif.entityId);
+    }, filter, [&preconditionCalls](const Notification<IntComponent>&) {
+        ++preconditionCalls;
+        return true;
+    });
+
+    for (entity_id e : entities) {
+        reg.insert(e, IntComponent());
+    }
+    reg.remove(entities[3]);
+    reg.remove(entities[2]);
+
+    EXPECT_EQ(std::vector<entity_id>({ entities[1], entities[3], entities[3] }), notified);
+    EXPECT_EQ(3, preconditionCalls);
+}
+
+TEST(RegistryShould, NotifyOnlyAboutSubscribedOperations)
+{
+    registry reg;
+    std::vector<entity_id> entities = reg.createEntities(2);
+
+    std::vector<operation_t> operations;
+    subscription_filter filter;
+    filter.operations = operation_bit(operation_t::inserted) | operation_bit(operation_t::removed);
+    auto unsubscribe = reg.subscribe<IntComponent>([&operations](const Notification<IntComponent>& notif) {
+        operations.push_back(notif.operation);
+    }, filter);
+
+    std::vector<std::pair<entity_id, IntComponent>> components(1);
+    components[0].first = entities[1];
+    reg.insert(entities[0], IntComponent());
+    reg.insert_many<IntComponent>(components);
+    reg.update(entities[0], IntComponent());
+    reg.remove<IntComponent>(entities[0]);
+
+    unsubscribe();
+    reg.remove<IntComponent>(entities[1]);
+
+    EXPECT_EQ(std::vector<operation_t>({ operation_t::inserted, operation_t::inserted, operation_t::removed }), operations);
+}
@@ -0,0 +1,489 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <persistent_table.h>
+#include <registry.h>
+#include <sparse_set_storage.h>
+
+#include "TestComponents.h"
+
+using namespace ecs;
+
+struct StorageShould : public ::testing::TestWithParam<std::tuple<storage_t, size_t>>
+{
+    storage_t type() const { return std::get<0>(GetParam()); }
+    size_t shards() const { return std::get<1>(GetParam()); }
+};
+
+TEST_P(StorageShould, InsertUpdateAndRemoveComponent)
+{
+    registry reg(type(), shards());
+    entity_id e = reg.createEntity();
+
+    IntComponent intC;
+    intC.number = 10;
+    ASSERT_TRUE(reg.insert(e, std::move(intC)));
+    ASSERT_FALSE(reg.insert(e, IntComponent()));
+    EXPECT_EQ(10, reg.select<IntComponent>(e)->number);
+    EXPECT_EQ(nullptr, reg.select<StringComponent>(e));
+
+    auto updated = reg.select<IntComponent>(e)->clone();
+    auto outdated = reg.select<IntComponent>(e)->clone();
+    updated.number = 20;
+    ASSERT_TRUE(reg.update(e, std::move(updated)));
+    ASSERT_FALSE(reg.update(e, std::move(outdated)));
+    EXPECT_EQ(20, reg.select<IntComponent>(e)->number);
+
+    ASSERT_TRUE(reg.remove<IntComponent>(e));
+    ASSERT_FALSE(reg.remove<IntComponent>(e));
+    EXPECT_EQ(nullptr, reg.select<IntComponent>(e));
+}
+
+TEST_P(StorageShould, CollectOnlyEntitiesHavingAllComponents)
+{
+    registry reg(type(), shards());
+    std::vector<entity_id> ids;
+    for (int i = 0; i < 10; ++i) {
+        entity_id e = reg.createEntity();
+        ids.push_back(e);
+        IntComponent intC;
+        intC.number = i;
+        reg.insert(e, std::move(intC));
+        if (i % 2 == 0) {
+            StringComponent strC;
+            strC.name = std::to_string(i);
+            reg.insert(e, std::move(strC));
+        }
+    }
+
+    auto ints = reg.select<IntComponent>();
+    EXPECT_EQ(10, ints.entities().size());
+
+    auto both = reg.select<StringComponent, IntComponent>();
+    ASSERT_EQ(5, both.entities().size());
+    for (entity_id e : both.entities()) {
+        EXPECT_EQ(std::to_string(both.select<IntComponent>(e)->number),
+            both.select<StringComponent>(e)->name);
+    }
+}
+
+TEST_P(StorageShould, RemoveEntityWithAllItsComponents)
+{
+    registry reg(type(), shards());
+    entity_id e1 = reg.createEntity();
+    entity_id e2 = reg.createEntity();
+    reg.insert(e1, IntComponent());
+    reg.insert(e2, IntComponent());
+    reg.insert(e2, StringComponent());
+
+    int removals = 0;
+    reg.subscribe<IntComponent>([&removals](const Notification<IntComponent>& notif) {
+        if (notif.operation == operation_t::removed) ++removals;
+    });
+
+    ASSERT_TRUE(reg.remove(e2));
+    ASSERT_FALSE(reg.remove(e2));
+    EXPECT_EQ(1, removals);
+    EXPECT_EQ(nullptr, reg.select<IntComponent>(e2));
+    EXPECT_FALSE(reg.insert(e2, IntComponent()));
+
+    auto ints = reg.select<IntComponent>();
+    ASSERT_EQ(1, ints.entities().size());
+    EXPECT_EQ(e1, ints.entities().front());
+}
+
+TEST_P(StorageShould, KeepComponentsWhenEntitiesChangeTheirSetOfComponents)
+{
+    registry reg(type(), shards());
+    std::vector<entity_id> ids;
+    for (int i = 0; i < 5000; ++i) {
+        entity_id e = reg.createEntity();
+        ids.push_back(e);
+        IntComponent intC;
+        intC.number = i;
+        reg.insert(e, std::move(intC));
+        reg.insert(e, StringComponent());
+    }
+
+    for (size_t i = 0; i < ids.size(); i += 2) {
+        ASSERT_TRUE(reg.remove<StringComponent>(ids[i]));
+    }
+    for (size_t i = 0; i < ids.size(); i += 3) {
+        ASSERT_TRUE(reg.remove(ids[i]));
+    }
+
+    auto both = reg.select<IntComponent, StringComponent>();
+    auto ints = reg.select<IntComponent>();
+    size_t expectedBoth = 0;
+    size_t expectedInts = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i % 3 == 0) {
+            EXPECT_EQ(nullptr, reg.select<IntComponent>(ids[i]));
+            continue;
+        }
+        ++expectedInts;
+        EXPECT_EQ(static_cast<int>(i), reg.select<IntComponent>(ids[i])->number);
+        if (i % 2 != 0) {
+            ++expectedBoth;
+            EXPECT_EQ(static_cast<int>(i), both.select<IntComponent>(ids[i])->number);
+        }
+    }
+    EXPECT_EQ(expectedBoth, both.entities().size());
+    EXPECT_EQ(expectedInts, ints.entities().size());
+}
+
+TEST_P(StorageShould, RecycleIndicesOfRemovedEntitiesAndRejectStaleIds)
+{
+    registry reg(type(), shards());
+    entity_id first = reg.createEntity();
+    reg.insert(first, IntComponent());
+    ASSERT_TRUE(reg.remove(first));
+
+    entity_id second = reg.createEntity();
+    EXPECT_EQ(index_of(first), index_of(second));
+    EXPECT_NE(generation_of(first), generation_of(second));
+
+    EXPECT_FALSE(reg.insert(first, IntComponent()));
+    EXPECT_TRUE(reg.insert(second, IntComponent()));
+    EXPECT_EQ(nullptr, reg.select<IntComponent>(first));
+    EXPECT_NE(nullptr, reg.select<IntComponent>(second));
+    EXPECT_FALSE(reg.remove<IntComponent>(first));
+    EXPECT_FALSE(reg.remove(first));
+    EXPECT_NE(nullptr, reg.select<IntComponent>(second));
+
+    auto ints = reg.select<IntComponent>();
+    ASSERT_EQ(1, ints.entities().size());
+    EXPECT_EQ(second, ints.entities().front());
+}
+
+TEST_P(StorageShould, CreateEntitiesAndInsertComponentsInBulk)
+{
+    registry reg(type(), shards());
+    entity_id removed = reg.createEntity();
+    reg.remove(removed);
+
+    auto ids = reg.createEntities(3000);
+    ASSERT_EQ(3000, ids.size());
+    EXPECT_EQ(index_of(removed), index_of(ids.front()));
+
+    size_t notifications = 0;
+    reg.subscribe<IntComponent>([&notifications](const Notification<IntComponent>& notif) {
+        if (notif.operation == operation_t::inserted) ++notifications;
+    });
+
+    std::vector<std::pair<entity_id, IntComponent>> ints;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        IntComponent intC;
+        intC.number = static_cast<int>(i);
+        ints.emplace_back(ids[i], intC);
+    }
+    ints.emplace_back(removed, IntComponent());
+
+    EXPECT_EQ(ids.size(), reg.insert_many<IntComponent>(ints));
+    EXPECT_EQ(ids.size(), notifications);
+    EXPECT_EQ(0, reg.insert_many<IntComponent>(std::move(ints)));
+    EXPECT_EQ(ids.size(), notifications);
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ASSERT_EQ(static_cast<int>(i), reg.select<IntComponent>(ids[i])->number);
+    }
+    EXPECT_EQ(ids.size(), reg.select<IntComponent>().entities().size());
+}
+
+TEST_P(StorageShould, StreamEntitiesLazilyThroughQuery)
+{
+    registry reg(type(), shards());
+    for (int i = 0; i < 100; ++i) {
+        entity_id e = reg.createEntity();
+        IntComponent intC;
+        intC.number = i;
+        reg.insert(e, std::move(intC));
+        if (i % 3 == 0) {
+            reg.insert(e, StringComponent());
+        }
+    }
+
+    auto materialized = reg.select<IntComponent, StringComponent>();
+    std::vector<entity_id> streamed;
+    for (const auto& row : reg.query<IntComponent, StringComponent>()) {
+        entity_id id = std::get<0>(row);
+        ASSERT_EQ(materialized.select<IntComponent>(id)->number, std::get<1>(row)->number);
+        ASSERT_NE(nullptr, std::get<2>(row));
+        streamed.push_back(id);
+    }
+    auto expected = materialized.entities();
+    std::sort(expected.begin(), expected.end());
+    std::sort(streamed.begin(), streamed.end());
+    EXPECT_EQ(expected, streamed);
+
+    auto ints = reg.query<IntComponent>();
+    size_t visited = 0;
+    for (auto iter = ints.begin(); iter != ints.end(); ++iter) {
+        if (++visited == 5) {
+            break;
+        }
+    }
+    EXPECT_EQ(5, visited);
+
+    registry empty(type(), shards());
+    empty.createEntity();
+    auto none = empty.query<IntComponent>();
+    EXPECT_TRUE(none.begin() == none.end());
+}
+
+TEST_P(StorageShould, SelectWithExcludedAndOptionalComponents)
+{
+    registry reg(type(), shards());
+    for (int i = 0; i < 60; ++i) {
+        entity_id e = reg.createEntity();
+        reg.insert(e, IntComponent());
+        if (i % 2 == 0) {
+            reg.insert(e, StringComponent());
+        }
+        if (i % 3 == 0) {
+            reg.insert(e, MarkerComponent());
+        }
+    }
+
+    auto unmarked = reg.select<IntComponent, without<MarkerComponent>>();
+    EXPECT_EQ(40, unmarked.entities().size());
+
+    auto neither = reg.select<IntComponent, without<MarkerComponent, StringComponent>>();
+    EXPECT_EQ(20, neither.entities().size());
+    for (entity_id id : neither.entities()) {
+        EXPECT_EQ(nullptr, reg.select<StringComponent>(id));
+    }
+
+    auto withString = reg.select<IntComponent, optional<StringComponent>>();
+    ASSERT_EQ(60, withString.entities().size());
+    std::atomic<size_t> strings{ 0 };
+    withString.parallel_for_each([&strings](entity_id, const IntComponent&, const StringComponent* s) {
+        strings += s != nullptr;
+    });
+    EXPECT_EQ(30, strings);
+
+    size_t streamed = 0;
+    for ([[maybe_unused]] const auto& row : reg.query<optional<StringComponent>, without<IntComponent>>()) {
+        ++streamed;
+    }
+    EXPECT_EQ(0, streamed);
+    for (const auto& row : reg.query<MarkerComponent, optional<StringComponent>, without<StringComponent>>()) {
+        EXPECT_EQ(nullptr, std::get<2>(row));
+        ++streamed;
+    }
+    EXPECT_EQ(10, streamed);
+}
+
+TEST_P(StorageShould, SelectWithOnlyOptionalComponents)
+{
+    registry reg(type(), shards());
+    std::vector<entity_id> entities = reg.createEntities(10);
+    for (size_t i = 0; i < entities.size(); i += 2) {
+        reg.insert(entities[i], IntComponent());
+    }
+
+    // no entity has ever had a MarkerComponent
+    auto markers = reg.select<optional<MarkerComponent>>();
+    EXPECT_EQ(10, markers.entities().size());
+    for (entity_id id : markers.entities()) {
+        EXPECT_EQ(nullptr, markers.select<MarkerComponent>(id));
+    }
+
+    auto ints = reg.select<optional<IntComponent>, optional<MarkerComponent>>();
+    ASSERT_EQ(10, ints.entities().size());
+    size_t withInt = 0;
+    for (entity_id id : ints.entities()) {
+        withInt += ints.select<IntComponent>(id) != nullptr;
+    }
+    EXPECT_EQ(5, withInt);
+}
+
+TEST_P(StorageShould, HandleConcurrentWritersOfDifferentEntities)
+{
+    registry reg(type(), shards());
+    const int numOfThreads = 8;
+    const int entitiesPerThread = 200;
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < numOfThreads; ++t) {
+        writers.emplace_back([&reg]() {
+            for (int i = 0; i < entitiesPerThread; ++i) {
+                entity_id e = reg.createEntity();
+                reg.insert(e, IntComponent());
+                auto updated = reg.select<IntComponent>(e)->clone();
+                updated.number = i;
+                ASSERT_TRUE(reg.update(e, std::move(updated)));
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+
+    auto ints = reg.select<IntComponent>();
+    EXPECT_EQ(numOfThreads * entitiesPerThread, ints.entities().size());
+}
+
+TEST_P(StorageShould, ApplyEveryConcurrentModificationOfSharedComponent)
+{
+    registry reg(type(), shards());
+    entity_id e = reg.createEntity();
+    reg.insert(e, IntComponent());
+
+    const int numOfThreads = 8;
+    const int incrementsPerThread = 200;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < numOfThreads; ++t) {
+        writers.emplace_back([&reg, e]() {
+            for (int i = 0; i < incrementsPerThread; ++i) {
+                ASSERT_TRUE(reg.modify<IntComponent>(e, [](IntComponent& c) { ++c.number; }, 100000));
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+
+    EXPECT_EQ(numOfThreads * incrementsPerThread, reg.select<IntComponent>(e)->number);
+}
+
+INSTANTIATE_TEST_CASE_P(AllStorages, StorageShould,
+    ::testing::Combine(
+        ::testing::Values(storage_t::entity_map, storage_t::sparse_set, storage_t::archetype),
+        ::testing::Values(1, 4)));
+
+TEST(ComponentPoolShould, KeepComponentsPackedAfterErase)
+{
+    component_pool pool;
+    for (entity_id id : { 3, 7, 9000, 11 }) {
+        auto c = std::make_shared<IntComponent>();
+        c->number = static_cast<int>(id);
+        ASSERT_TRUE(pool.insert(id, c));
+    }
+
+    ASSERT_TRUE(pool.erase(7));
+    ASSERT_FALSE(pool.erase(7));
+    ASSERT_EQ(3, pool.size());
+    EXPECT_EQ((std::vector<entity_id>{ 3, 11, 9000 }), pool.entities());
+    for (size_t i = 0; i < pool.size(); ++i) {
+        auto c = std::static_pointer_cast<const IntComponent>(pool.components()[i]);
+        EXPECT_EQ(pool.entities()[i], static_cast<entity_id>(c->number));
+    }
+    EXPECT_FALSE(pool.contains(7));
+    EXPECT_TRUE(pool.contains(9000));
+}
+
+TEST(PersistentTableShould, KeepOlderVersionsUntouched)
+{
+    persistent_table<int> empty;
+    auto first = empty.set(5, std::make_shared<int>(50));
+    auto second = first.set(100000, std::make_shared<int>(7)).set(5, std::make_shared<int>(51));
+    auto third = second.erase(5);
+
+    EXPECT_EQ(nullptr, empty.find(5));
+    ASSERT_NE(nullptr, first.find(5));
+    EXPECT_EQ(50, *first.find(5));
+    EXPECT_EQ(nullptr, first.find(100000));
+    EXPECT_EQ(51, *second.find(5));
+    EXPECT_EQ(7, *second.find(100000));
+    EXPECT_EQ(nullptr, third.find(5));
+    EXPECT_EQ(2, second.size());
+    EXPECT_EQ(1, third.size());
+
+    std::vector<size_t> keys;
+    second.for_each([&keys](size_t key, const int&) { keys.push_back(key); });
+    EXPECT_EQ((std::vector<size_t>{ 5, 100000 }), keys);
+}
+
+TEST(PersistentTableShould, ModifyInPlaceOnlyNodesNotSharedWithOtherVersions)
+{
+    persistent_table<int> first;
+    for (int i = 0; i < 100; ++i) {
+        first.put(i, std::make_shared<int>(i));
+    }
+
+    auto second = first;
+    for (int i = 0; i < 100; i += 2) {
+        second.put(i, std::make_shared<int>(-i));
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(i, *first.find(i));
+        ASSERT_EQ(i % 2 == 0 ? -i : i, *second.find(i));
+    }
+}
+
+TEST(PersistentTableShould, FindNextPresentKey)
+{
+    persistent_table<int> table;
+    for (int key : { 3, 40, 41, 5000 }) {
+        table.put(key, std::make_shared<int>(key));
+    }
+
+    std::vector<size_t> keys;
+    size_t key = 0;
+    while (const int* value = table.find_next(key)) {
+        EXPECT_EQ(key, static_cast<size_t>(*value));
+        keys.push_back(key++);
+    }
+
+    EXPECT_EQ(std::vector<size_t>({ 3, 40, 41, 5000 }), keys);
+}
+
+TEST(EntityMapStorageShould, BuildViewsFromConsistentSnapshotWhileWritersProceed)
+{
+    registry reg;
+    std::atomic<bool> done { false };
+
+    std::thread writer([&reg, &done]() {
+        for (int i = 0; i < 2000; ++i) {
+            entity_id e = reg.createEntity();
+            IntComponent intC;
+            intC.number = i;
+            reg.insert(e, std::move(intC));
+        }
+        done = true;
+    });
+
+    // entities are inserted in order, so every snapshot has to contain
+    // a continuous sequence of numbers starting from zero
+    while (!done) {
+        auto ints = reg.select<IntComponent>();
+        std::vector<int> numbers;
+        for (entity_id e : ints.entities()) {
+            numbers.push_back(ints.select<IntComponent>(e)->number);
+        }
+        std::sort(numbers.begin(), numbers.end());
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            ASSERT_EQ(static_cast<int>(i), numbers[i]);
+        }
+    }
+    writer.join();
+}
@@ -0,0 +1,62 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include <thread_pool.h>
+
+using namespace ecs;
+
+TEST(ThreadPoolShould, ProcessEveryElementExactlyOnce)
+{
+    thread_pool pool(3);
+    std::vector<std::atomic<int>> visits(10007);
+
+    pool.parallel_for(visits.size(), 100, [&visits](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ++visits[i];
+        }
+    });
+
+    for (const auto& v : visits) {
+        ASSERT_EQ(1, v.load());
+    }
+}
+
+TEST(ThreadPoolShould, RunNestedParallelLoopsWithoutDeadlock)
+{
+    thread_pool pool(2);
+    std::atomic<size_t> sum{ 0 };
+
+    pool.parallel_for(8, 1, [&pool, &sum](size_t, size_t) {
+        pool.parallel_for(100, 10, [&sum](size_t begin, size_t end) {
+            sum += end - begin;
+        });
+    });
+
+    EXPECT_EQ(800, sum.load());
+}
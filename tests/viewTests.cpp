@@ -28,6 +28,8 @@
 #include <component.h>
 #include <view.h>
 
+#include <atomic>
+
 #include "TestComponents.h"
 
 struct ViewShould : public ::testing::Test
@@ -80,7 +82,7 @@ TEST_F(ViewShould, BeCreatedAndHandleSelectRequestWithPredicate)
 {
     ecs::view<StringComponent, IntComponent> myView(std::move(entities), std::move(components));
 
-    auto mapOfFounds = myView.select<IntComponent>([](auto& ptr) {
+    auto mapOfFounds = myView.select<IntComponent>([](const auto& ptr) {
         return ptr->number < 15 || ptr->number > 25;
     });
 
@@ -95,3 +97,86 @@ TEST_F(ViewShould, BeCreatedAndHandleSelectRequestWithPredicate)
     ASSERT_EQ(17, thirdEl.first);
     ASSERT_EQ(30, thirdEl.second->number);
 }
+
+TEST_F(ViewShould, SelectComponentsOfEveryEntityOfLargeView)
+{
+    const size_t numOfEntities = 100000;
+    std::vector<ecs::entity_id> ids;
+    std::vector<ecs::component_const_ptr> resources;
+    for (size_t i = 0; i < numOfEntities; ++i) {
+        auto intComp = std::make_shared<IntComponent>();
+        intComp->number = static_cast<int>(i);
+        ids.push_back(numOfEntities - i);
+        resources.push_back(intComp);
+    }
+    ecs::view<IntComponent> myView(std::move(ids), std::move(resources));
+
+    for (ecs::entity_id id : myView.entities()) {
+        ASSERT_EQ(static_cast<int>(numOfEntities - id), myView.select<IntComponent>(id)->number);
+    }
+    EXPECT_EQ(nullptr, myView.select<IntComponent>(numOfEntities + 1));
+}
+
+TEST_F(ViewShould, GiveTypedColumnsAndPlainPointersToComponents)
+{
+    const ecs::view<StringComponent, IntComponent> myView(std::move(entities), std::move(components));
+
+    const auto& ints = myView.column<IntComponent>();
+    const auto& strings = myView.column<const StringComponent>();
+    ASSERT_EQ(3, ints.size());
+    ASSERT_EQ(3, strings.size());
+    EXPECT_EQ(20, ints[1]->number);
+    EXPECT_EQ("CCC", strings[2]->name);
+
+    const IntComponent* intComp = myView.get<IntComponent>(10);
+    ASSERT_NE(nullptr, intComp);
+    EXPECT_EQ(ints[1].get(), intComp);
+    EXPECT_EQ(nullptr, myView.get<StringComponent>(5));
+}
+
+TEST_F(ViewShould, FindRowsOfUnorderedEntitiesAfterBeingMoved)
+{
+    entities = { 17, 4, 10 };
+    ecs::view<StringComponent, IntComponent> myView(std::move(entities), std::move(components));
+    ASSERT_NE(nullptr, myView.get<IntComponent>(4));
+    EXPECT_EQ(20, myView.get<IntComponent>(4)->number);
+
+    ecs::view<StringComponent, IntComponent> moved(std::move(myView));
+    ASSERT_NE(nullptr, moved.get<IntComponent>(10));
+    EXPECT_EQ(30, moved.get<IntComponent>(10)->number);
+    EXPECT_EQ("AAA", moved.select<StringComponent>(17)->name);
+    EXPECT_EQ(nullptr, moved.get<IntComponent>(5));
+}
+
+TEST_F(ViewShould, IterateAndSelectRowsInParallel)
+{
+    const size_t numOfEntities = 50000;
+    std::vector<ecs::entity_id> ids;
+    std::vector<ecs::component_const_ptr> resources;
+    for (size_t i = 0; i < numOfEntities; ++i) {
+        auto strComp = std::make_shared<StringComponent>();
+        auto intComp = std::make_shared<IntComponent>();
+        intComp->number = static_cast<int>(i);
+        ids.push_back(i);
+        resources.push_back(strComp);
+        resources.push_back(intComp);
+    }
+    ecs::view<StringComponent, IntComponent> myView(std::move(ids), std::move(resources));
+    ecs::thread_pool pool(4);
+
+    std::atomic<long long> sum{ 0 };
+    myView.parallel_for_each([&sum](ecs::entity_id id, const StringComponent&, const IntComponent& intComp) {
+        sum += intComp.number - static_cast<long long>(id);
+    }, pool, 1000);
+    EXPECT_EQ(0, sum.load());
+
+    auto odd = myView.parallel_select<IntComponent>([](const IntComponent& c) {
+        return c.number % 2 == 1;
+    }, pool, 1000);
+
+    ASSERT_EQ(numOfEntities / 2, odd.size());
+    for (size_t i = 0; i < odd.size(); ++i) {
+        ASSERT_EQ(2 * i + 1, odd[i].first);
+        ASSERT_EQ(static_cast<int>(2 * i + 1), odd[i].second->number);
+    }
+}
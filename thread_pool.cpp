@@ -0,0 +1,150 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace ecs
+{
+namespace
+{
+struct parallel_job
+{
+    std::function<void(size_t, size_t)> f;
+    size_t count;
+    size_t chunkSize;
+    size_t numOfChunks;
+    std::atomic<size_t> nextChunk{ 0 };
+    size_t finishedChunks = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    // processes chunks until none is left to claim
+    void run() {
+        size_t processed = 0;
+        for (size_t chunk = nextChunk++; chunk < numOfChunks; chunk = nextChunk++) {
+            size_t begin = chunk * chunkSize;
+            f(begin, std::min(begin + chunkSize, count));
+            ++processed;
+        }
+
+        if (processed == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedChunks += processed;
+        if (finishedChunks == numOfChunks) {
+            finished.notify_all();
+        }
+    }
+};
+}
+
+thread_pool::thread_pool(size_t numOfThreads)
+{
+    numOfThreads = std::max<size_t>(numOfThreads, 1);
+    for (size_t i = 0; i < numOfThreads; ++i) {
+        mWorkers.emplace_back([this]() { work(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mCondition.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+size_t thread_pool::size() const
+{
+    return mWorkers.size();
+}
+
+void thread_pool::parallel_for(size_t count, size_t chunkSize, std::function<void(size_t, size_t)> f)
+{
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    size_t numOfChunks = (count + chunkSize - 1) / chunkSize;
+    if (numOfChunks <= 1) {
+        if (count > 0) {
+            f(0, count);
+        }
+        return;
+    }
+
+    // helpers may start after the caller has returned, the job outlives it
+    auto job = std::make_shared<parallel_job>();
+    job->f = std::move(f);
+    job->count = count;
+    job->chunkSize = chunkSize;
+    job->numOfChunks = numOfChunks;
+
+    size_t numOfHelpers = std::min(mWorkers.size(), numOfChunks - 1);
+    for (size_t i = 0; i < numOfHelpers; ++i) {
+        submit([job]() { job->run(); });
+    }
+    job->run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->finishedChunks == job->numOfChunks; });
+}
+
+thread_pool& thread_pool::shared()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void thread_pool::work()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopped || !mTasks.empty(); });
+            if (mTasks.empty()) {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+} // namespace ecs
@@ -27,7 +27,16 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include "component.h"
+#include "query_terms.h"
+#include "thread_pool.h"
 
 namespace ecs
 {
@@ -37,85 +46,201 @@ using entity_id = size_t;
 template<typename... Ts>
 struct view
 {
+    // resources hold sizeof...(Ts) components per entity, ordered as Ts
     view(std::vector<entity_id>&& entities, std::vector<component_const_ptr>&& resources)
         : mEntities(std::move(entities))
-        , mNumOfComponentsPerEntity(sizeof...(Ts))
-        , mResources(std::move(resources))
     {
-        setupComponentIndexing();
+        assert(resources.size() == mEntities.size() * sizeof...(Ts));
+        fillColumns(resources, std::index_sequence_for<Ts...>());
     }
 
+    // the index of rows is not moved, it gets built again when needed
     view(view&& other)
         : mEntities(std::move(other.mEntities))
-        , mNumOfComponentsPerEntity(std::move(other.mNumOfComponentsPerEntity))
-        , mResources(std::move(other.mResources))
+        , mColumns(std::move(other.mColumns))
     {}
 
     template<class T>
-    std::shared_ptr<const T> select(entity_id id)
+    std::shared_ptr<const T> select(entity_id id) const
     {
-        size_t entityIndex = 0;
-        bool isEntityIndexFound = false;
-        for (; entityIndex < mEntities.size(); ++entityIndex) {
-            if (mEntities.at(entityIndex) == id) {
-                isEntityIndexFound = true;
-                break;
-            }
-        }
-
-        if (!isEntityIndexFound) {
+        size_t row = find(id);
+        if (row == mEntities.size()) {
             return std::shared_ptr<const T>();
         }
 
-        size_t offset = entityIndex * mNumOfComponentsPerEntity + GetComponentIndex<T>::index;
-        return std::dynamic_pointer_cast<const T>(mResources[offset]);
+        return column<T>()[row];
     }
 
+    // plain access without touching the reference count,
+    // valid as long as the view exists
+    template<class T>
+    const T* get(entity_id id) const
+    {
+        size_t row = find(id);
+        if (row == mEntities.size()) {
+            return nullptr;
+        }
+
+        return column<T>()[row].get();
+    }
 
     template<class T>
-    std::map<entity_id, std::shared_ptr<const T>> select(std::function<bool(std::shared_ptr<const T>)> predicate) {
+    std::map<entity_id, std::shared_ptr<const T>> select(std::function<bool(std::shared_ptr<const T>)> predicate) const {
         std::map<entity_id, std::shared_ptr<const T>> result;
-        for (size_t entityIndex = 0; entityIndex < mEntities.size(); ++entityIndex) {
-            size_t offset = entityIndex * mNumOfComponentsPerEntity + GetComponentIndex<T>::index;
-            assert(offset < mResources.size());
-            const auto component = std::dynamic_pointer_cast<const T>(mResources[offset]);
-            if (!predicate(component)) {
+        const auto& components = column<T>();
+        for (size_t row = 0; row < mEntities.size(); ++row) {
+            if (!predicate(components[row])) {
                 continue;
             }
-            result.insert(std::make_pair(mEntities.at(entityIndex), component));
+            result.insert(std::make_pair(mEntities[row], components[row]));
         }
         return result;
     }
 
-    const std::vector<entity_id>& entities() { return mEntities; }
+    static constexpr size_t PARALLEL_CHUNK_SIZE = 4096;
+
+    // calls f(id, const Ts&...) for every row (optional<T> is passed as
+    // const T*), chunks of rows run concurrently
+    // on the pool so f has to be safe to call from many threads
+    template<class F>
+    void parallel_for_each(F&& f, thread_pool& pool = thread_pool::shared(),
+        size_t chunkSize = PARALLEL_CHUNK_SIZE) const
+    {
+        pool.parallel_for(mEntities.size(), chunkSize, [this, &f](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row) {
+                invoke(f, row, std::index_sequence_for<Ts...>());
+            }
+        });
+    }
+
+    // rows whose T satisfies predicate(const T&), in the order of entities()
+    template<class T, class Predicate>
+    std::vector<std::pair<entity_id, std::shared_ptr<const T>>> parallel_select(Predicate&& predicate,
+        thread_pool& pool = thread_pool::shared(), size_t chunkSize = PARALLEL_CHUNK_SIZE) const
+    {
+        using match = std::pair<entity_id, std::shared_ptr<const T>>;
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        std::vector<std::vector<match>> chunks((mEntities.size() + chunkSize - 1) / chunkSize);
+
+        const auto& components = column<T>();
+        pool.parallel_for(mEntities.size(), chunkSize, [&](size_t begin, size_t end) {
+            auto& matches = chunks[begin / chunkSize];
+            for (size_t row = begin; row < end; ++row) {
+                if (components[row] && predicate(*components[row])) {
+                    matches.emplace_back(mEntities[row], components[row]);
+                }
+            }
+        });
+
+        std::vector<match> result;
+        size_t total = 0;
+        for (const auto& matches : chunks) {
+            total += matches.size();
+        }
+        result.reserve(total);
+        for (auto& matches : chunks) {
+            std::move(matches.begin(), matches.end(), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    // components of type T, row i belongs to entities()[i]
+    template<class T>
+    const std::vector<std::shared_ptr<const T>>& column() const {
+        return std::get<GetComponentIndex<T>::index>(mColumns);
+    }
+
+    const std::vector<entity_id>& entities() const { return mEntities; }
 
 private:
+    template<class T, class... Rest>
+    struct TypePosition;
+
+    template<class T, class... Rest>
+    struct TypePosition<T, T, Rest...> : std::integral_constant<size_t, 0> {};
+
+    template<class T, class U, class... Rest>
+    struct TypePosition<T, U, Rest...> : std::integral_constant<size_t, 1 + TypePosition<T, Rest...>::value> {};
+
+    // position of T among Ts, resolved at compile time
     template<class T>
     struct GetComponentIndex
     {
-        static int index;
+        static constexpr size_t index = TypePosition<std::remove_cv_t<T>, component_of_t<Ts>...>::value;
     };
 
-    static void setupComponentIndexing() {
-        setupComponentIndexingImpl<Ts...>(0);
+    // row of the entity or entities().size() if it is not in the view,
+    // rows are indexed on the first lookup so views only iterated pay nothing
+    size_t find(entity_id id) const
+    {
+        std::call_once(mIndexed, [this]() { index(); });
+        if (mRowsById.empty()) {
+            auto it = std::lower_bound(mEntities.begin(), mEntities.end(), id);
+            return it != mEntities.end() && *it == id ? it - mEntities.begin() : mEntities.size();
+        }
+
+        auto it = std::lower_bound(mRowsById.begin(), mRowsById.end(), id,
+            [this](size_t row, entity_id id) { return mEntities[row] < id; });
+        return it != mRowsById.end() && mEntities[*it] == id ? *it : mEntities.size();
     }
 
-    template<class T>
-    static void setupComponentIndexingImpl(size_t id) {
-        GetComponentIndex<T>::index = id;
+    // storages often return entities in ascending order, then they are searched directly
+    void index() const
+    {
+        mRowsById.clear();
+        if (std::is_sorted(mEntities.begin(), mEntities.end())) {
+            return;
+        }
+        mRowsById.resize(mEntities.size());
+        for (size_t row = 0; row < mEntities.size(); ++row) {
+            mRowsById[row] = row;
+        }
+        std::sort(mRowsById.begin(), mRowsById.end(),
+            [this](size_t lhs, size_t rhs) { return mEntities[lhs] < mEntities[rhs]; });
     }
 
-    template<class T1, class T2, class... Rest>
-    static void setupComponentIndexingImpl(size_t id) {
-        GetComponentIndex<T1>::index = id;
-        setupComponentIndexingImpl<T2, Rest...>(id + 1);
+    template<class F, size_t... Is>
+    void invoke(F& f, size_t row, std::index_sequence<Is...>) const {
+        f(mEntities[row], argument<Is>(row)...);
+    }
+
+    // optional components are passed as pointers, the rest as references
+    template<size_t I>
+    decltype(auto) argument(size_t row) const {
+        const auto& c = std::get<I>(mColumns)[row];
+        if constexpr (is_optional<std::tuple_element_t<I, std::tuple<Ts...>>>::value) {
+            return c.get();
+        }
+        else {
+            return *c;
+        }
+    }
+
+    template<size_t I>
+    using component_t = component_of_t<std::tuple_element_t<I, std::tuple<Ts...>>>;
+
+    using columns = std::tuple<std::vector<std::shared_ptr<const component_of_t<Ts>>>...>;
+
+    template<size_t... Is>
+    void fillColumns(const std::vector<component_const_ptr>& resources, std::index_sequence<Is...>) {
+        (fillColumn<Is>(resources), ...);
+    }
+
+    // tags were matched by the storage, so the static cast is safe
+    template<size_t I>
+    void fillColumn(const std::vector<component_const_ptr>& resources) {
+        auto& components = std::get<I>(mColumns);
+        components.reserve(mEntities.size());
+        for (size_t offset = I; offset < resources.size(); offset += sizeof...(Ts)) {
+            components.push_back(std::static_pointer_cast<const component_t<I>>(resources[offset]));
+        }
     }
 
 private:
     std::vector<entity_id> mEntities;
-    size_t mNumOfComponentsPerEntity;
-    std::vector<component_const_ptr> mResources;
+    mutable std::once_flag mIndexed;
+    // rows ordered by entity id, empty if mEntities is sorted already
+    mutable std::vector<size_t> mRowsById;
+    columns mColumns;
 };
-
-template<class... Ts> template<class T> int view<Ts...>::GetComponentIndex<T>::index = 0;
 } //
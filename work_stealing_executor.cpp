@@ -0,0 +1,139 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include "work_stealing_executor.h"
+
+#include <algorithm>
+
+#include "reactive_system.h"
+
+namespace ecs
+{
+namespace
+{
+// executor and index of the worker running on this thread
+thread_local const work_stealing_executor* currentExecutor = nullptr;
+thread_local size_t currentWorker = 0;
+}
+
+work_stealing_executor::work_stealing_executor(size_t numOfWorkers)
+{
+    numOfWorkers = std::max<size_t>(numOfWorkers, 1);
+    for (size_t i = 0; i < numOfWorkers; ++i) {
+        mWorkers.push_back(std::make_unique<worker>());
+    }
+}
+
+work_stealing_executor::~work_stealing_executor()
+{
+    stop();
+    join();
+}
+
+size_t work_stealing_executor::size() const
+{
+    return mWorkers.size();
+}
+
+void work_stealing_executor::start()
+{
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->thread = std::thread([this, i]() { work(i); });
+    }
+}
+
+void work_stealing_executor::submit(std::unique_ptr<command> c)
+{
+    // counted before it is visible, so a worker taking it never sees zero
+    mPending.fetch_add(1);
+    size_t index = currentExecutor == this
+        ? currentWorker
+        : mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    {
+        std::lock_guard<std::mutex> lock(mWorkers[index]->mutex);
+        mWorkers[index]->tasks.push_back(std::move(c));
+    }
+
+    // taking the lock orders the wake up after a worker checked mPending
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    mWakeUp.notify_one();
+}
+
+void work_stealing_executor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStopped = true;
+    }
+    mWakeUp.notify_all();
+}
+
+void work_stealing_executor::join()
+{
+    for (auto& w : mWorkers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+}
+
+void work_stealing_executor::work(size_t index)
+{
+    currentExecutor = this;
+    currentWorker = index;
+    while (!mStopped) {
+        if (std::unique_ptr<command> c = take(index)) {
+            mPending.fetch_sub(1);
+            c->execute();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWakeUp.wait(lock, [this]() { return mStopped || mPending.load() > 0; });
+    }
+}
+
+std::unique_ptr<command> work_stealing_executor::take(size_t index)
+{
+    {
+        worker& own = *mWorkers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            auto c = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return c;
+        }
+    }
+
+    for (size_t i = 1; i < mWorkers.size(); ++i) {
+        worker& victim = *mWorkers[(index + i) % mWorkers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            auto c = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return c;
+        }
+    }
+    return nullptr;
+}
+} // namespace ecs
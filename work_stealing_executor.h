@@ -0,0 +1,80 @@
+/*
+ * AsyncECS
+ * Copyright (c) 2018 kamxgal Kamil Galant kamil.galant@gmail.com
+ *
+ * MIT licence
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecs
+{
+struct command;
+
+// Runs commands on a fixed set of workers. Every worker owns a deque, takes
+// its newest command first and steals the oldest ones from other workers when
+// its own deque runs dry. Commands submitted by a worker go to its own deque,
+// the ones from other threads are spread round-robin.
+class work_stealing_executor
+{
+public:
+    // commands submitted before start wait in the deques of the workers
+    explicit work_stealing_executor(size_t numOfWorkers);
+    // pending commands are dropped, running ones are finished
+    ~work_stealing_executor();
+
+    work_stealing_executor(const work_stealing_executor&) = delete;
+    work_stealing_executor& operator=(const work_stealing_executor&) = delete;
+
+    size_t size() const;
+    void start();
+    void submit(std::unique_ptr<command> c);
+    // makes workers exit once their current command is done
+    void stop();
+    void join();
+
+private:
+    struct worker
+    {
+        std::deque<std::unique_ptr<command>> tasks;
+        std::mutex mutex;
+        std::thread thread;
+    };
+
+    void work(size_t index);
+    std::unique_ptr<command> take(size_t index);
+
+    std::vector<std::unique_ptr<worker>> mWorkers;
+    std::atomic<size_t> mNextWorker{ 0 };
+    // sleeping workers are woken when pending commands appear
+    std::atomic<size_t> mPending{ 0 };
+    std::mutex mSleepMutex;
+    std::condition_variable mWakeUp;
+    std::atomic<bool> mStopped{ false };
+};
+} // namespace ecs